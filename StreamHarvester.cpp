@@ -13,10 +13,39 @@
 #include <thread>
 #include <algorithm>
 #include <cctype>
-#include <regex>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <ctime>
 #include <cstdio>      // fileno
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <fcntl.h>
+#include <memory>
+#include <csignal>
 #ifndef _WIN32
-#include <unistd.h>    // isatty
+#include <unistd.h>    // isatty, fsync
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <cerrno>
+#ifdef __linux__
+#include <sys/syscall.h>   // ioprio_set
+#endif
+extern char **environ;
 #endif
 
 namespace fs = std::filesystem;
@@ -24,6 +53,7 @@ namespace fs = std::filesystem;
 #ifdef _WIN32
   #define EXE_EXT ".exe"
   #include <windows.h>
+  #include <io.h>
   // Some older Windows SDKs might not define this; provide a safe fallback
   #ifndef DISABLE_NEWLINE_AUTO_RETURN
   #define DISABLE_NEWLINE_AUTO_RETURN 0
@@ -70,6 +100,29 @@ static void clear_screen() {
 #endif
 }
 
+// Start of a status-line rewrite: carriage return, plus erase-line when ANSI is on.
+static const char *line_reset() { return g_ansi_enabled ? "\r\x1b[2K" : "\r"; }
+
+static bool stdout_is_terminal() {
+#ifdef _WIN32
+    return _isatty(_fileno(stdout)) != 0;
+#else
+    return isatty(fileno(stdout)) != 0;
+#endif
+}
+
+// Columns of the terminal on stdout, 80 when unknown.
+static int terminal_width() {
+#ifdef _WIN32
+    CONSOLE_SCREEN_BUFFER_INFO csbi;
+    if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &csbi)) return csbi.srWindow.Right - csbi.srWindow.Left + 1;
+#else
+    struct winsize ws;
+    if (ioctl(fileno(stdout), TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) return ws.ws_col;
+#endif
+    return 80;
+}
+
 // ---------- Banner ----------
 static const std::vector<std::string> BANNER_LINES = {
 "            __",
@@ -133,9 +186,131 @@ static std::string trim(const std::string &s) {
     while (b>a && std::isspace((unsigned char)s[b-1])) --b;
     return s.substr(a, b-a);
 }
+static bool starts_with(const std::string &s, const char *prefix) {
+    return s.compare(0, std::strlen(prefix), prefix) == 0;
+}
+#ifdef _WIN32
+// Only the PowerShell installers still go through a shell.
 static int exec_system(const std::string &cmd) {
     return std::system(cmd.c_str());
 }
+#endif
+// Thin wrappers over the POSIX / MSVCRT file descriptor calls used for journals.
+#ifdef _WIN32
+static int fd_open_append(const std::string &p) { return _open(p.c_str(), _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE); }
+static bool fd_write(int fd, const std::string &s) { return _write(fd, s.data(), (unsigned)s.size()) == (int)s.size(); }
+static int fd_sync(int fd) { return _commit(fd); }
+static int fd_truncate(int fd) { return _chsize(fd, 0); }
+static void fd_close(int fd) { _close(fd); }
+#else
+static int fd_open_append(const std::string &p) { return ::open(p.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644); }
+static bool fd_write(int fd, const std::string &s) { return ::write(fd, s.data(), s.size()) == (ssize_t)s.size(); }
+static int fd_sync(int fd) { return ::fsync(fd); }
+static int fd_truncate(int fd) { return ::ftruncate(fd, 0); }
+static void fd_close(int fd) { ::close(fd); }
+#endif
+// Opens p (created if missing) and blocks until this process holds an
+// exclusive advisory lock on it; -1 when that is not possible (no lock
+// daemon on an NFS mount, say). fd_unlock drops the lock and closes it.
+#ifdef _WIN32
+static int fd_lock(const std::string &p) {
+    int fd = _open(p.c_str(), _O_RDWR | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+    OVERLAPPED ov{};
+    if (fd >= 0 && !LockFileEx((HANDLE)_get_osfhandle(fd), LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &ov)) { _close(fd); return -1; }
+    return fd;
+}
+static void fd_unlock(int fd) { OVERLAPPED ov{}; UnlockFileEx((HANDLE)_get_osfhandle(fd), 0, 1, 0, &ov); _close(fd); }
+#else
+static int fd_lock(const std::string &p) {
+    int fd = ::open(p.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+    struct flock fl{};
+    fl.l_type = F_WRLCK;
+    fl.l_whence = SEEK_SET;
+    int r;
+    while ((r = ::fcntl(fd, F_SETLKW, &fl)) != 0 && errno == EINTR) {}
+    if (r != 0) { ::close(fd); return -1; }
+    return fd;
+}
+static void fd_unlock(int fd) { ::close(fd); }   // closing drops the fcntl() lock
+#endif
+// Replaces dest with src in one step, so readers see either the old or the new file.
+static bool replace_file(const std::string &src, const std::string &dest) {
+#ifdef _WIN32
+    return MoveFileExA(src.c_str(), dest.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return std::rename(src.c_str(), dest.c_str()) == 0;
+#endif
+}
+
+// Read-only view of a whole file (mmap / file mapping); empty if the file is
+// missing or empty.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path) {
+#ifdef _WIN32
+        HANDLE f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                               nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (f == INVALID_HANDLE_VALUE) return;
+        LARGE_INTEGER sz;
+        if (GetFileSizeEx(f, &sz) && sz.QuadPart > 0) {
+            HANDLE m = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (m) {
+                data_ = (const char*)MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+                if (data_) size_ = (size_t)sz.QuadPart;
+                CloseHandle(m);
+            }
+        }
+        CloseHandle(f);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                data_ = (const char*)p;
+                size_ = (size_t)st.st_size;
+                madvise(p, size_, MADV_SEQUENTIAL);
+            }
+        }
+        ::close(fd);
+#endif
+    }
+    ~MappedFile() {
+        if (!data_) return;
+#ifdef _WIN32
+        UnmapViewOfFile(data_);
+#else
+        munmap((void*)data_, size_);
+#endif
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile &operator=(const MappedFile&) = delete;
+
+    const char *begin() const { return data_; }
+    const char *end() const { return data_ + size_; }
+
+private:
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Advances p past the next line in [p, end) that is not blank and not a '#'
+// comment; [b, e) is that line without surrounding whitespace.
+static bool next_entry(const char *&p, const char *end, const char *&b, const char *&e) {
+    while (p < end) {
+        const char *nl = (const char*)std::memchr(p, '\n', (size_t)(end - p));
+        b = p;
+        e = nl ? nl : end;
+        p = nl ? nl + 1 : end;
+        while (b < e && std::isspace((unsigned char)*b)) ++b;
+        while (e > b && std::isspace((unsigned char)e[-1])) --e;
+        if (b < e && *b != '#') return true;
+    }
+    return false;
+}
+
 static std::string sanitize_name(const std::string &s) {
     std::string out;
     for (char c : s) {
@@ -151,8 +326,47 @@ struct Config {
     std::string mode = "video";      // "video" or "audio"
     std::string quality = "best";    // "best", "720", "1080", ...
     std::string targetFormat = "original"; // "original", "mp4", "mp3"
+    int jobs = 1;                    // concurrent yt-dlp processes
+    int perHost = 2;                 // max concurrent downloads against one host
+    int batch = 1;                   // URLs handed to one yt-dlp process (--batch-file)
+    bool adaptive = false;           // tune concurrency at run time, with jobs as the ceiling
+    uint64_t rateLimit = 0;          // bytes/s shared by all downloads, 0 = unlimited
+    std::string prometheusFile;      // metrics in Prometheus text format, "" = off
+    bool prefetch = false;           // resolve metadata ahead of the downloads
+    int infoTtl = 3600;              // seconds a prefetched info JSON stays usable
+    std::string order = "fifo";      // with prefetch: "fifo", "sjf" (smallest first), "ljf" (largest first)
+    uint64_t minFree = 0;            // with prefetch: bytes to keep free in downloads/
+    int stallTimeout = 120;          // seconds without progress before a job is killed and requeued, 0 = never
+    int jobTimeout = 0;              // seconds a job may run in all, 0 = no limit
+    bool dedup = false;              // hardlink identical finished files to one copy
 };
 
+static int parse_int_clamped(const std::string &s, int def, int lo, int hi) {
+    int v = def;
+    try { v = std::stoi(s); } catch(...) { return def; }
+    return std::max(lo, std::min(hi, v));
+}
+
+// "500K", "10M", "1.5G" or plain bytes per second, as yt-dlp's --limit-rate takes them.
+static uint64_t parse_rate(const std::string &s, uint64_t def) {
+    double v = 0;
+    size_t used = 0;
+    try { v = std::stod(s, &used); } catch(...) { return def; }
+    if (v < 0) return def;
+    std::string unit = trim(s.substr(used));
+    if (!unit.empty()) {
+        char u = (char)std::toupper((unsigned char)unit[0]);
+        if (u == 'K') v *= 1024; else if (u == 'M') v *= 1048576; else if (u == 'G') v *= 1073741824.0;
+        else return def;
+    }
+    return (uint64_t)v;
+}
+static std::string format_rate(uint64_t bps) {
+    if (bps && bps % 1048576 == 0) return std::to_string(bps / 1048576) + "M";
+    if (bps && bps % 1024 == 0) return std::to_string(bps / 1024) + "K";
+    return std::to_string(bps);
+}
+
 static Config load_config(const std::string &path) {
     Config c;
     std::ifstream f(path);
@@ -163,6 +377,19 @@ static Config load_config(const std::string &path) {
         if (line.rfind("mode=",0)==0) c.mode = line.substr(5);
         if (line.rfind("quality=",0)==0) c.quality = line.substr(8);
         if (line.rfind("format=",0)==0) c.targetFormat = line.substr(7);
+        if (line.rfind("jobs=",0)==0) c.jobs = parse_int_clamped(line.substr(5), 1, 1, 64);
+        if (line.rfind("per_host=",0)==0) c.perHost = parse_int_clamped(line.substr(9), 2, 1, 64);
+        if (line.rfind("batch=",0)==0) c.batch = parse_int_clamped(line.substr(6), 1, 1, 1000);
+        if (line.rfind("adaptive=",0)==0) c.adaptive = (line.substr(9) == "1" || line.substr(9) == "yes");
+        if (line.rfind("rate_limit=",0)==0) c.rateLimit = parse_rate(line.substr(11), 0);
+        if (line.rfind("prometheus_file=",0)==0) c.prometheusFile = line.substr(16);
+        if (line.rfind("prefetch=",0)==0) c.prefetch = (line.substr(9) == "1" || line.substr(9) == "yes");
+        if (line.rfind("info_ttl=",0)==0) c.infoTtl = parse_int_clamped(line.substr(9), 3600, 60, 7 * 86400);
+        if (line.rfind("order=",0)==0) { std::string o = line.substr(6); if (o == "fifo" || o == "sjf" || o == "ljf") c.order = o; }
+        if (line.rfind("min_free=",0)==0) c.minFree = parse_rate(line.substr(9), 0);
+        if (line.rfind("stall_timeout=",0)==0) c.stallTimeout = parse_int_clamped(line.substr(14), 120, 0, 86400);
+        if (line.rfind("job_timeout=",0)==0) c.jobTimeout = parse_int_clamped(line.substr(12), 0, 0, 7 * 86400);
+        if (line.rfind("dedup=",0)==0) c.dedup = (line.substr(6) == "1" || line.substr(6) == "yes");
     }
     return c;
 }
@@ -172,14 +399,381 @@ static void save_config(const std::string &path, const Config &c) {
     f << "mode=" << c.mode << "\n";
     f << "quality=" << c.quality << "\n";
     f << "format=" << c.targetFormat << "\n";
+    f << "jobs=" << c.jobs << "\n";
+    f << "per_host=" << c.perHost << "\n";
+    f << "batch=" << c.batch << "\n";
+    f << "adaptive=" << (c.adaptive ? 1 : 0) << "\n";
+    f << "rate_limit=" << format_rate(c.rateLimit) << "\n";
+    f << "prometheus_file=" << c.prometheusFile << "\n";
+    f << "prefetch=" << (c.prefetch ? 1 : 0) << "\n";
+    f << "info_ttl=" << c.infoTtl << "\n";
+    f << "order=" << c.order << "\n";
+    f << "min_free=" << format_rate(c.minFree) << "\n";
+    f << "stall_timeout=" << c.stallTimeout << "\n";
+    f << "job_timeout=" << c.jobTimeout << "\n";
+    f << "dedup=" << (c.dedup ? 1 : 0) << "\n";
+}
+
+// ---------- Process engine ----------
+// Children are started from an argv vector (posix_spawn, no shell) with
+// stdout and stderr on non-blocking pipes. One poll() loop multiplexes any
+// number of them and reports each output line and, on exit, the status and
+// resource usage. Without posix_spawn (Windows) every child gets a reader
+// thread over _popen instead; kill() is then best-effort.
+struct ChildResult {
+    int exitCode = -1;        // exit status, or 128+signal when killed
+    int signal = 0;
+    double userSec = 0, sysSec = 0;
+    long maxRssKb = 0;
+    double wallSec = 0;
+};
+
+#ifndef _WIN32
+// A pipe whose ends are close-on-exec from the start, so a child spawned by
+// another thread in between never inherits them. macOS has no pipe2().
+static int cloexec_pipe(int fds[2]) {
+#ifdef __APPLE__
+    if (pipe(fds) != 0) return -1;
+    for (int i = 0; i < 2; ++i) fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+    return 0;
+#else
+    return pipe2(fds, O_CLOEXEC);
+#endif
+}
+#endif
+
+class ProcessEngine {
+public:
+    using LineFn = std::function<void(const std::string &line, bool fromStderr)>;
+    using ExitFn = std::function<void(const ChildResult &r)>;
+
+    ProcessEngine() {
+#ifndef _WIN32
+        if (cloexec_pipe(wake_) == 0) for (int fd : wake_) fcntl(fd, F_SETFL, O_NONBLOCK);
+#endif
+    }
+    ~ProcessEngine() {
+        for (auto &c : children_) kill(c->id, true);
+        while (!children_.empty()) poll_once(50);
+#ifndef _WIN32
+        for (int fd : wake_) if (fd >= 0) close(fd);
+#endif
+    }
+    ProcessEngine(const ProcessEngine&) = delete;
+    ProcessEngine &operator=(const ProcessEngine&) = delete;
+
+    size_t running() const { return children_.size(); }
+
+#ifndef _WIN32
+    // Starts argv[0] (searched in PATH when it has no '/'). Returns a child id, or -1.
+    int spawn(const std::vector<std::string> &argv, LineFn onLine, ExitFn onExit) {
+        if (argv.empty()) return -1;
+        int out[2], err[2];
+        // the dup2 file actions clear close-on-exec on the child's fds 1 and 2
+        if (cloexec_pipe(out) != 0) return -1;
+        if (cloexec_pipe(err) != 0) { close(out[0]); close(out[1]); return -1; }
+        for (int fd : {out[0], err[0]}) fcntl(fd, F_SETFL, O_NONBLOCK);
+
+        posix_spawn_file_actions_t fa;
+        posix_spawn_file_actions_init(&fa);
+        posix_spawn_file_actions_adddup2(&fa, out[1], 1);
+        posix_spawn_file_actions_adddup2(&fa, err[1], 2);
+        posix_spawn_file_actions_addclose(&fa, out[1]);
+        posix_spawn_file_actions_addclose(&fa, err[1]);
+        std::vector<char*> cargv;
+        for (auto &a : argv) cargv.push_back(const_cast<char*>(a.c_str()));
+        cargv.push_back(nullptr);
+        pid_t pid = 0;
+        int rc = posix_spawnp(&pid, cargv[0], &fa, nullptr, cargv.data(), environ);
+        posix_spawn_file_actions_destroy(&fa);
+        close(out[1]); close(err[1]);
+        if (rc != 0) { close(out[0]); close(err[0]); return -1; }
+
+        std::unique_ptr<Child> c(new Child);
+        c->id = nextId_++; c->pid = pid; c->fd[0] = out[0]; c->fd[1] = err[0];
+        c->onLine = std::move(onLine); c->onExit = std::move(onExit);
+        c->start = std::chrono::steady_clock::now();
+        children_.push_back(std::move(c));
+        return children_.back()->id;
+    }
+
+    // SIGTERM (or SIGKILL when hard) to a running child; its exit is reported as usual.
+    void kill(int id, bool hard = false) {
+        for (auto &c : children_) if (c->id == id && !c->reaped) ::kill(c->pid, hard ? SIGKILL : SIGTERM);
+    }
+
+    // OS process id of a child, or 0.
+    long pid_of(int id) const {
+        for (auto &c : children_) if (c->id == id) return (long)c->pid;
+        return 0;
+    }
+
+    // Background priority for CPU-bound children: nice 10 and, on Linux, the
+    // lowest best-effort I/O class (what "ionice -c2 -n7" sets).
+    void lower_priority(int id) {
+        for (auto &c : children_) {
+            if (c->id != id || c->reaped) continue;
+            setpriority(PRIO_PROCESS, c->pid, 10);
+#if defined(__linux__) && defined(SYS_ioprio_set)
+            syscall(SYS_ioprio_set, 1 /* IOPRIO_WHO_PROCESS */, (int)c->pid, (2 << 13) | 7 /* class BE, level 7 */);
+#endif
+        }
+    }
+
+    // Waits up to timeoutMs for output, exits or wake(), dispatching callbacks.
+    void poll_once(int timeoutMs) {
+        std::vector<pollfd> pfds;
+        std::vector<std::pair<Child*, int>> owners;
+        pfds.push_back({wake_[0], POLLIN, 0});
+        owners.push_back({nullptr, 0});
+        bool reaping = false;
+        for (auto &c : children_) {
+            for (int s = 0; s < 2; ++s) if (c->fd[s] >= 0) { pfds.push_back({c->fd[s], POLLIN, 0}); owners.push_back({c.get(), s}); }
+            if (c->fd[0] < 0 && c->fd[1] < 0) reaping = true;
+        }
+        // a child that closed its pipes but has not exited yet is re-checked soon
+        int n = poll(pfds.data(), pfds.size(), reaping ? std::min(timeoutMs, 5) : timeoutMs);
+        if (n > 0) {
+            for (size_t i = 0; i < pfds.size(); ++i) {
+                if (!pfds[i].revents) continue;
+                if (!owners[i].first) { char b[64]; while (read(wake_[0], b, sizeof(b)) > 0) {} continue; }
+                drain(*owners[i].first, owners[i].second);
+            }
+        }
+        reap();
+    }
+
+    // Interrupts a poll_once() running on another thread.
+    void wake() { if (wake_[1] >= 0) { char b = 1; (void)!write(wake_[1], &b, 1); } }
+
+private:
+    struct Child {
+        int id = 0;
+        pid_t pid = 0;
+        int fd[2] = {-1, -1};        // stdout, stderr read ends
+        std::string buf[2];
+        LineFn onLine;
+        ExitFn onExit;
+        std::chrono::steady_clock::time_point start;
+        bool reaped = false;
+    };
+
+    void drain(Child &c, int s) {
+        char chunk[65536];
+        while (true) {
+            ssize_t r = read(c.fd[s], chunk, sizeof(chunk));
+            if (r > 0) { emit(c, s, chunk, (size_t)r); continue; }
+            if (r < 0 && (errno == EAGAIN || errno == EINTR)) return;
+            // EOF: flush a trailing partial line
+            if (!c.buf[s].empty()) { if (c.onLine) c.onLine(c.buf[s], s == 1); c.buf[s].clear(); }
+            close(c.fd[s]);
+            c.fd[s] = -1;
+            return;
+        }
+    }
+
+    void emit(Child &c, int s, const char *p, size_t n) {
+        const char *end = p + n;
+        while (p < end) {
+            const char *nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            if (!nl) { c.buf[s].append(p, end - p); return; }
+            if (c.buf[s].empty()) { if (c.onLine) c.onLine(std::string(p, nl - p + 1), s == 1); }
+            else { c.buf[s].append(p, nl - p + 1); if (c.onLine) c.onLine(c.buf[s], s == 1); c.buf[s].clear(); }
+            p = nl + 1;
+        }
+    }
+
+    void reap() {
+        std::vector<std::unique_ptr<Child>> done;
+        std::vector<ChildResult> results;
+        for (auto it = children_.begin(); it != children_.end();) {
+            Child &c = **it;
+            if (c.fd[0] >= 0 || c.fd[1] >= 0) { ++it; continue; }
+            int status = 0;
+            rusage ru{};
+            if (wait4(c.pid, &status, WNOHANG, &ru) != c.pid) { ++it; continue; }
+            ChildResult r;
+            if (WIFEXITED(status)) r.exitCode = WEXITSTATUS(status);
+            else if (WIFSIGNALED(status)) { r.signal = WTERMSIG(status); r.exitCode = 128 + r.signal; }
+            r.userSec = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6;
+            r.sysSec = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+            r.maxRssKb = ru.ru_maxrss;
+            r.wallSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - c.start).count();
+            c.reaped = true;
+            results.push_back(r);
+            done.push_back(std::move(*it));
+            it = children_.erase(it);
+        }
+        // callbacks run last: they may spawn or kill other children
+        for (size_t i = 0; i < done.size(); ++i) if (done[i]->onExit) done[i]->onExit(results[i]);
+    }
+
+    std::vector<std::unique_ptr<Child>> children_;
+    int wake_[2] = {-1, -1};
+    int nextId_ = 1;
+#else
+    int spawn(const std::vector<std::string> &argv, LineFn onLine, ExitFn onExit) {
+        if (argv.empty()) return -1;
+        std::string cmd = "\"";
+        for (size_t i = 0; i < argv.size(); ++i) cmd += (i ? " \"" : "\"") + argv[i] + "\"";
+        cmd += " 2>&1\"";   // cmd /c strips the outer quotes
+        FILE *p = _popen(cmd.c_str(), "r");
+        if (!p) return -1;
+        std::unique_ptr<Child> c(new Child);
+        c->id = nextId_++; c->onLine = std::move(onLine); c->onExit = std::move(onExit);
+        c->start = std::chrono::steady_clock::now();
+        int id = c->id;
+        c->reader = std::thread([this, p, id] {
+            char buf[4096];
+            std::string line;
+            while (fgets(buf, sizeof(buf), p)) {
+                line += buf;
+                if (line.back() != '\n') continue;
+                push({id, false, line, 0});
+                line.clear();
+            }
+            if (!line.empty()) push({id, false, line, 0});
+            push({id, true, "", _pclose(p)});
+        });
+        children_.push_back(std::move(c));
+        return id;
+    }
+    void kill(int, bool = false) {}
+    long pid_of(int) const { return 0; }
+    void lower_priority(int) {}
+    void poll_once(int timeoutMs) {
+        std::deque<Event> evs;
+        {
+            std::unique_lock<std::mutex> lk(m_);
+            cv_.wait_for(lk, std::chrono::milliseconds(timeoutMs), [&] { return !events_.empty() || woken_; });
+            evs.swap(events_);
+            woken_ = false;
+        }
+        for (auto &e : evs) {
+            auto it = std::find_if(children_.begin(), children_.end(), [&](const std::unique_ptr<Child> &c) { return c->id == e.id; });
+            if (it == children_.end()) continue;
+            if (!e.exited) { if ((*it)->onLine) (*it)->onLine(e.line, false); continue; }
+            std::unique_ptr<Child> c = std::move(*it);
+            children_.erase(it);
+            c->reader.join();
+            ChildResult r;
+            r.exitCode = e.status;
+            r.wallSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - c->start).count();
+            if (c->onExit) c->onExit(r);
+        }
+    }
+    void wake() { std::lock_guard<std::mutex> lk(m_); woken_ = true; cv_.notify_all(); }
+
+private:
+    struct Event { int id; bool exited; std::string line; int status; };
+    struct Child {
+        int id = 0;
+        std::thread reader;
+        LineFn onLine;
+        ExitFn onExit;
+        std::chrono::steady_clock::time_point start;
+    };
+    void push(Event e) { std::lock_guard<std::mutex> lk(m_); events_.push_back(std::move(e)); cv_.notify_all(); }
+
+    std::vector<std::unique_ptr<Child>> children_;
+    std::mutex m_;
+    std::condition_variable cv_;
+    std::deque<Event> events_;
+    bool woken_ = false;
+    int nextId_ = 1;
+#endif
+};
+
+// Runs argv to completion; the first output line goes to firstLine when given.
+static int run_process(const std::vector<std::string> &argv, std::string *firstLine = nullptr) {
+    ProcessEngine engine;
+    int rc = -1;
+    bool exited = false;
+    auto onLine = [&](const std::string &l, bool) { if (firstLine && firstLine->empty()) *firstLine = trim(l); };
+    if (engine.spawn(argv, onLine, [&](const ChildResult &r) { rc = r.exitCode; exited = true; }) < 0) return -1;
+    while (!exited) engine.poll_once(1000);
+    return rc;
+}
+
+// Shell-style rendering of an argv for "[CMD]" lines.
+static std::string display_cmd(const std::vector<std::string> &argv) {
+    std::string out;
+    for (auto &a : argv) {
+        bool plain = !a.empty() && a.find_first_of(" \t\"'\\$`()[]<>|&;*?%+") == std::string::npos;
+        out += (out.empty() ? "" : " ") + (plain ? a : "\"" + a + "\"");
+    }
+    return out;
 }
 
 // ---------- Tool Installer (kept) ----------
+// internals/tools.manifest remembers what the tools looked like after the last
+// full check, one tab-separated line per tool:
+//   name  path  size  mtime  version  executable
+// When a few stat calls show nothing changed, startup skips every subprocess.
+struct ToolRecord {
+    std::string name, path, version;
+    bool present = false, executable = false;
+    uint64_t size = 0;
+    long long mtime = 0;
+    bool same_file(const ToolRecord &o) const {
+        return present == o.present && executable == o.executable && size == o.size && mtime == o.mtime && path == o.path;
+    }
+};
+
+static ToolRecord stat_tool(const std::string &name, const std::string &path) {
+    ToolRecord r;
+    r.name = name; r.path = path;
+    std::error_code ec;
+    auto st = fs::status(path, ec);
+    if (ec || !fs::is_regular_file(st)) return r;
+    r.present = true;
+    r.size = fs::file_size(path, ec);
+    r.mtime = (long long)fs::last_write_time(path, ec).time_since_epoch().count();
+#ifdef _WIN32
+    r.executable = true;
+#else
+    r.executable = (st.permissions() & fs::perms::owner_exec) != fs::perms::none;
+#endif
+    return r;
+}
+
 class ToolInstaller {
 public:
     ToolInstaller() { ensure_dir("internals"); }
+    ~ToolInstaller() { if (probe_.joinable()) probe_.join(); }
+    ToolInstaller(const ToolInstaller&) = delete;
+    ToolInstaller &operator=(const ToolInstaller&) = delete;
     std::string yt_dlp_path() const { return std::string("internals/yt-dlp") + EXE_EXT; }
     std::string ffmpeg_path() const { return std::string("internals/ffmpeg") + EXE_EXT; }
+    static std::string manifest_path() { return "internals/tools.manifest"; }
+
+    // True when both tools are installed and exactly as recorded by the last
+    // full check. A tool recorded as missing is never fresh, so a failed
+    // install is tried again on the next start.
+    bool manifest_fresh() const {
+        auto m = load_manifest();
+        for (auto cur : {stat_tool("yt-dlp", yt_dlp_path()), stat_tool("ffmpeg", ffmpeg_path())}) {
+            auto it = m.find(cur.name);
+            if (it == m.end() || !it->second.same_file(cur) || !cur.present || !cur.executable) return false;
+        }
+        return true;
+    }
+
+    // Records the tools' current state; versions are probed on a background
+    // thread so startup does not wait for a Python interpreter.
+    void refresh_manifest() {
+        if (probe_.joinable()) probe_.join();
+        std::map<std::string, ToolRecord> m;
+        for (auto r : {stat_tool("yt-dlp", yt_dlp_path()), stat_tool("ffmpeg", ffmpeg_path())}) m[r.name] = r;
+        save_manifest(m);
+        probe_ = std::thread([m]() mutable {
+            for (auto &kv : m) {
+                if (!kv.second.present) continue;
+                run_process({kv.second.path, kv.first == "ffmpeg" ? "-version" : "--version"}, &kv.second.version);
+            }
+            save_manifest(m);
+        });
+    }
 
     bool ensure_yt_dlp() {
         std::string dest = yt_dlp_path();
@@ -187,10 +781,10 @@ public:
         std::cout << "[*] Downloading yt-dlp -> " << dest << "\n";
 #ifdef _WIN32
         std::string cmd = "powershell -Command \"Invoke-WebRequest -Uri 'https://github.com/yt-dlp/yt-dlp/releases/latest/download/yt-dlp.exe' -OutFile '" + dest + "'\"";
+        int r = exec_system(cmd);
 #else
-        std::string cmd = "curl -L -s -o \"" + dest + "\" \"https://github.com/yt-dlp/yt-dlp/releases/latest/download/yt-dlp\" && chmod +x \"" + dest + "\"";
+        int r = run_process({"curl", "-L", "-s", "-o", dest, "https://github.com/yt-dlp/yt-dlp/releases/latest/download/yt-dlp"});
 #endif
-        int r = exec_system(cmd);
         if (r==0 && file_exists(dest)) { make_executable(dest); std::cout << "[OK] yt-dlp installed\n"; return true; }
         std::cerr << "[WARN] yt-dlp download failed (exit " << r << ")\n";
         return false;
@@ -205,14 +799,15 @@ public:
         std::string work = "internals/ffmpeg_tmp";
         ensure_dir(work);
         std::cout << "[*] Downloading static ffmpeg (this may take a bit)...\n";
-        std::string cmd = "curl -L -s -o \"" + tmp + "\" \"" + url + "\" && mkdir -p \"" + work + "\" && tar -xJf \"" + tmp + "\" -C \"" + work + "\" --strip-components=1 2>/dev/null";
-        int r = exec_system(cmd);
-        if (r != 0) {
+        auto fetch = [&](const std::string &from) {
+            if (run_process({"curl", "-L", "-s", "-o", tmp, from}) != 0) return false;
+            ensure_dir(work);
+            return run_process({"tar", "-xJf", tmp, "-C", work, "--strip-components=1"}) == 0;
+        };
+        if (!fetch(url)) {
             try{ fs::remove(tmp); fs::remove_all(work);}catch(...){}
             std::string alt = "https://github.com/BtbN/FFmpeg-Builds/releases/latest/download/ffmpeg-master-latest-linux64-gpl.tar.xz";
-            cmd = "curl -L -s -o \"" + tmp + "\" \"" + alt + "\" && mkdir -p \"" + work + "\" && tar -xJf \"" + tmp + "\" -C \"" + work + "\" --strip-components=1 2>/dev/null";
-            r = exec_system(cmd);
-            if (r != 0) { try{ fs::remove(tmp); fs::remove_all(work);}catch(...){} return false; }
+            if (!fetch(alt)) { try{ fs::remove(tmp); fs::remove_all(work);}catch(...){} return false; }
         }
         std::string found;
         for (auto &p : fs::recursive_directory_iterator(work)) {
@@ -247,10 +842,359 @@ public:
 private:
     static void make_executable(const std::string &path) {
 #ifndef _WIN32
-        std::string cmd = "chmod +x \"" + path + "\"";
-        exec_system(cmd);
+        std::error_code ec;   // chmod(2), no shell
+        fs::permissions(path, fs::perms::owner_exec | fs::perms::group_exec | fs::perms::others_exec, fs::perm_options::add, ec);
 #endif
     }
+
+    static std::map<std::string, ToolRecord> load_manifest() {
+        std::map<std::string, ToolRecord> m;
+        std::ifstream f(manifest_path());
+        std::string line;
+        while (std::getline(f, line)) {
+            std::vector<std::string> col;
+            size_t a = 0, b;
+            while ((b = line.find('\t', a)) != std::string::npos) { col.push_back(line.substr(a, b - a)); a = b + 1; }
+            col.push_back(line.substr(a));
+            if (col.size() != 6) continue;
+            ToolRecord r;
+            r.name = col[0]; r.path = col[1]; r.version = col[4]; r.executable = col[5] == "1";
+            r.present = col[2] != "-";
+            try { r.size = r.present ? std::stoull(col[2]) : 0; r.mtime = std::stoll(col[3]); } catch(...) { continue; }
+            m[r.name] = r;
+        }
+        return m;
+    }
+
+    static void save_manifest(const std::map<std::string, ToolRecord> &m) {
+        std::string tmp = manifest_path() + ".tmp";
+        {
+            std::ofstream f(tmp);
+            if (!f) return;
+            for (auto &kv : m) {
+                const ToolRecord &r = kv.second;
+                f << r.name << '\t' << r.path << '\t' << (r.present ? std::to_string(r.size) : "-") << '\t' << r.mtime
+                  << '\t' << r.version << '\t' << (r.executable ? 1 : 0) << '\n';
+            }
+        }
+        replace_file(tmp, manifest_path());
+    }
+
+    std::thread probe_;
+};
+
+// ---------- URL canonicalization + download archive ----------
+// Host part of a URL, lowercased and without "www.".
+static std::string url_host(const std::string &url) {
+    size_t a = url.find("://");
+    a = (a == std::string::npos) ? 0 : a + 3;
+    size_t b = url.find_first_of("/?#", a);
+    std::string h = url.substr(a, b == std::string::npos ? std::string::npos : b - a);
+    size_t at = h.rfind('@');
+    if (at != std::string::npos) h = h.substr(at + 1);
+    size_t colon = h.find(':');
+    if (colon != std::string::npos) h = h.substr(0, colon);
+    for (auto &c : h) c = (char)std::tolower((unsigned char)c);
+    if (h.rfind("www.",0)==0) h = h.substr(4);
+    return h;
+}
+
+static bool is_video_id_char(char c) { return std::isalnum((unsigned char)c) || c=='-' || c=='_'; }
+
+// Leading run of id characters at pos (stops at '/', '?', '&', '#', ...).
+static std::string id_at(const std::string &s, size_t pos) {
+    size_t e = pos;
+    while (e < s.size() && is_video_id_char(s[e])) ++e;
+    return s.substr(pos, e - pos);
+}
+
+// Value of query parameter 'key', or "" when absent.
+static std::string query_param(const std::string &url, const std::string &key) {
+    size_t q = url.find('?');
+    while (q != std::string::npos) {
+        size_t k = q + 1;
+        if (url.compare(k, key.size() + 1, key + "=") == 0) {
+            size_t e = url.find_first_of("&#", k);
+            return url.substr(k + key.size() + 1, e == std::string::npos ? std::string::npos : e - k - key.size() - 1);
+        }
+        q = url.find('&', k);
+    }
+    return "";
+}
+
+// Reduces a URL to a dedup key in yt-dlp's --download-archive format,
+// "<extractor> <id>", for the sites we can recognize without a network
+// round trip (youtu.be/x and youtube.com/watch?v=x&t=3 both give "youtube x").
+// Anything else becomes "url <normalized url>": lowercase scheme and host,
+// no "www.", no fragment and no tracking parameters.
+static std::string canonical_key(const std::string &rawUrl) {
+    std::string url = trim(rawUrl);
+    std::string host = url_host(url);
+    size_t hs = url.find("://");
+    hs = (hs == std::string::npos) ? 0 : hs + 3;
+    size_t ps = url.find_first_of("/?#", hs);
+    std::string path = ps == std::string::npos ? "/" : url.substr(ps);
+
+    auto ends_with_host = [&](const char *dom) {
+        std::string d = dom;
+        return host == d || (host.size() > d.size() && host.compare(host.size() - d.size() - 1, std::string::npos, "." + d) == 0);
+    };
+    if (host == "youtu.be") {
+        std::string id = id_at(path, 1);
+        if (id.size() == 11) return "youtube " + id;
+    }
+    if (ends_with_host("youtube.com") || ends_with_host("youtube-nocookie.com")) {
+        std::string id;
+        if (path.rfind("/watch",0)==0) id = query_param(path, "v");
+        for (const char *pre : {"/shorts/", "/embed/", "/live/", "/v/"})
+            if (id.empty() && path.rfind(pre,0)==0) id = id_at(path, std::strlen(pre));
+        if (id.size() == 11) return "youtube " + id;
+    }
+    if (ends_with_host("vimeo.com")) {
+        std::string id = id_at(path, 1);
+        if (!id.empty() && std::all_of(id.begin(), id.end(), ::isdigit)) return "vimeo " + id;
+    }
+    if (ends_with_host("twitter.com") || ends_with_host("x.com")) {
+        size_t st = path.find("/status/");
+        if (st != std::string::npos) { std::string id = id_at(path, st + 8); if (!id.empty()) return "twitter " + id; }
+    }
+    if (ends_with_host("tiktok.com")) {
+        size_t v = path.find("/video/");
+        if (v != std::string::npos) { std::string id = id_at(path, v + 7); if (!id.empty()) return "tiktok " + id; }
+    }
+    if (ends_with_host("dailymotion.com") && path.rfind("/video/",0)==0) {
+        std::string id = id_at(path, 7);
+        if (!id.empty()) return "dailymotion " + id;
+    }
+
+    // generic: normalize and keep only meaningful query parameters
+    std::string scheme = hs >= 3 ? url.substr(0, hs - 3) : "https";
+    for (auto &c : scheme) c = (char)std::tolower((unsigned char)c);
+    size_t frag = path.find('#');
+    if (frag != std::string::npos) path.resize(frag);
+    size_t q = path.find('?');
+    std::string out = scheme + "://" + host + path.substr(0, q);
+    if (q != std::string::npos) {
+        std::string query = path.substr(q + 1), kept;
+        size_t a = 0;
+        while (a <= query.size()) {
+            size_t e = query.find('&', a);
+            if (e == std::string::npos) e = query.size();
+            std::string kv = query.substr(a, e - a);
+            std::string k = kv.substr(0, kv.find('='));
+            bool tracking = k.rfind("utm_",0)==0 || k=="fbclid" || k=="gclid" || k=="si" || k=="feature" || k=="ref";
+            if (!kv.empty() && !tracking) kept += (kept.empty() ? "" : "&") + kv;
+            a = e + 1;
+        }
+        if (!kept.empty()) out += "?" + kept;
+    }
+    return "url " + out;
+}
+
+// Playlist, channel and album URLs of the sites we know, which yt-dlp would
+// download item after item in one process. A watch URL with a list= parameter
+// is a single video here (--no-playlist).
+static bool is_collection_url(const std::string &rawUrl) {
+    std::string url = trim(rawUrl), host = url_host(url);
+    size_t hs = url.find("://");
+    hs = (hs == std::string::npos) ? 0 : hs + 3;
+    size_t ps = url.find_first_of("/?#", hs);
+    std::string path = ps == std::string::npos ? "/" : url.substr(ps);
+    auto on = [&](const char *dom) {
+        std::string d = dom;
+        return host == d || (host.size() > d.size() && host.compare(host.size() - d.size() - 1, std::string::npos, "." + d) == 0);
+    };
+    auto under = [&](std::initializer_list<const char*> prefixes) {
+        for (const char *p : prefixes) if (path.rfind(p, 0) == 0) return true;
+        return false;
+    };
+    if (on("youtube.com")) return (path.rfind("/playlist", 0) == 0 && !query_param(path, "list").empty())
+                                  || under({"/channel/", "/c/", "/user/", "/@"});
+    if (on("vimeo.com")) return under({"/channels/", "/showcase/", "/album/", "/groups/"});
+    if (on("dailymotion.com")) return under({"/playlist/"});
+    if (on("soundcloud.com")) return path.find("/sets/") != std::string::npos;
+    if (on("bandcamp.com")) return under({"/album/"});
+    if (on("tiktok.com")) return under({"/@"}) && path.find("/video/") == std::string::npos;
+    return false;
+}
+
+// 64-bit FNV-1a; in-memory dedup sets store these instead of full keys.
+static uint64_t hash64(const std::string &s) {
+    uint64_t h = 1469598103934665603ull;
+    for (unsigned char c : s) { h ^= c; h *= 1099511628211ull; }
+    return h;
+}
+
+// Keys of everything downloaded so far, one per line in internals/archive.txt.
+// Loaded into a hash set on first use; additions are appended, and refresh()
+// picks up the lines other instances appended since.
+class DownloadArchive {
+public:
+    static DownloadArchive &instance() { static DownloadArchive a; return a; }
+
+    bool contains(const std::string &key) {
+        std::lock_guard<std::mutex> lk(m_);
+        load();
+        return keys_.count(hash64(key)) != 0;
+    }
+    void add(const std::string &key) {
+        std::lock_guard<std::mutex> lk(m_);
+        load();
+        if (!keys_.insert(hash64(key)).second) return;
+        if (fd_ < 0) fd_ = fd_open_append(path());
+        if (fd_ >= 0 && !fd_write(fd_, key + "\n")) std::cerr << "[WARN] Failed to write download archive\n";
+    }
+    size_t size() { std::lock_guard<std::mutex> lk(m_); load(); return keys_.size(); }
+    void refresh() { std::lock_guard<std::mutex> lk(m_); if (loaded_) read_from(offset_); else load(); }
+
+private:
+    DownloadArchive() = default;
+    ~DownloadArchive() { if (fd_ >= 0) fd_close(fd_); }
+    static std::string path() { return "internals/archive.txt"; }
+    void load() {
+        if (loaded_) return;
+        loaded_ = true;
+        read_from(0);
+    }
+    // Adds the complete lines from byte offset on; caller holds m_.
+    void read_from(uint64_t offset) {
+        std::ifstream f(path(), std::ios::binary);
+        if (!f || !f.seekg((std::streamoff)offset)) return;
+        std::string line;
+        while (std::getline(f, line) && !f.eof()) {   // a last line without '\n' is still being written
+            offset += line.size() + 1;
+            offset_ = offset;
+            line = trim(line);
+            if (!line.empty()) keys_.insert(hash64(line));
+        }
+    }
+    std::mutex m_;
+    bool loaded_ = false;
+    uint64_t offset_ = 0;   // bytes of the file read so far
+    std::unordered_set<uint64_t> keys_;
+    int fd_ = -1;
+};
+
+// ---------- Metadata cache ----------
+// What the prefetch stage learned about a URL: yt-dlp's info JSON, from which
+// a later download can start without extracting again (--load-info-json),
+// plus the size and duration it reported (0 = unknown).
+struct MediaInfo {
+    std::string json;       // path of the info JSON
+    uint64_t bytes = 0;
+    double duration = 0;
+};
+
+// Info JSONs live in internals/infocache/<key hash>.info.json, keyed by
+// canonical_key(); internals/infocache/index has one
+// "<key hash>\t<fetched unix time>\t<bytes>\t<duration>" line per fetch, the
+// last one winning. Format URLs inside an info JSON expire after a few hours,
+// hence the TTL (info_ttl=); stale entries are dropped, with their files, when
+// the index is loaded.
+class InfoCache {
+public:
+    static InfoCache &instance() { static InfoCache c; return c; }
+    static std::string dir() { return "internals/infocache"; }
+
+    void set_ttl(int seconds) { std::lock_guard<std::mutex> lk(m_); ttl_ = seconds; }
+
+    static std::string key_hash(const std::string &url) {
+        char b[17];
+        std::snprintf(b, sizeof(b), "%016llx", (unsigned long long)hash64(canonical_key(url)));
+        return b;
+    }
+    static std::string json_path(const std::string &hash) { return dir() + "/" + hash + ".info.json"; }
+
+    // Fresh info for url, if there is any.
+    bool lookup(const std::string &url, MediaInfo &mi) {
+        std::lock_guard<std::mutex> lk(m_);
+        load();
+        std::string h = key_hash(url);
+        auto it = entries_.find(h);
+        if (it == entries_.end() || it->second.fetched + ttl_ <= (int64_t)std::time(nullptr)) return false;
+        std::error_code ec;
+        if (!fs::exists(json_path(h), ec)) { entries_.erase(it); return false; }
+        mi = it->second.info;
+        mi.json = json_path(h);
+        return true;
+    }
+
+    // Moves a freshly written info JSON into the cache; mi.json is updated.
+    bool store(const std::string &url, const std::string &file, MediaInfo &mi) {
+        std::lock_guard<std::mutex> lk(m_);
+        load();
+        std::string h = key_hash(url);
+        if (!replace_file(file, json_path(h))) return false;
+        mi.json = json_path(h);
+        Entry e{(int64_t)std::time(nullptr), mi};
+        entries_[h] = e;
+        if (fd_ < 0) fd_ = fd_open_append(index_path());
+        char line[96];
+        std::snprintf(line, sizeof(line), "%s\t%lld\t%llu\t%.1f\n", h.c_str(), (long long)e.fetched, (unsigned long long)mi.bytes, mi.duration);
+        if (fd_ >= 0 && !fd_write(fd_, line)) std::cerr << "[WARN] Failed to write info cache index\n";
+        return true;
+    }
+
+    // Drops url's info (used up, or no longer trusted). The index line goes
+    // away on the next load, since the file is gone.
+    void forget(const std::string &url) {
+        std::lock_guard<std::mutex> lk(m_);
+        std::string h = key_hash(url);
+        entries_.erase(h);
+        std::error_code ec;
+        fs::remove(json_path(h), ec);
+    }
+
+private:
+    struct Entry { int64_t fetched = 0; MediaInfo info; };
+
+    InfoCache() = default;
+    ~InfoCache() { if (fd_ >= 0) fd_close(fd_); }
+    static std::string index_path() { return dir() + "/index"; }
+
+    void load() {
+        if (loaded_) return;
+        loaded_ = true;
+        ensure_dir(dir());
+        std::ifstream f(index_path());
+        std::string line;
+        size_t lines = 0;
+        while (std::getline(f, line)) {
+            std::vector<std::string> col;
+            size_t a = 0;
+            for (size_t b; (b = line.find('\t', a)) != std::string::npos; a = b + 1) col.push_back(line.substr(a, b - a));
+            col.push_back(line.substr(a));
+            if (col.size() != 4 || col[0].size() != 16) continue;
+            lines++;
+            Entry e;
+            e.fetched = std::atoll(col[1].c_str());
+            e.info.bytes = std::strtoull(col[2].c_str(), nullptr, 10);
+            e.info.duration = std::atof(col[3].c_str());
+            entries_[col[0]] = e;
+        }
+        f.close();
+        int64_t now = (int64_t)std::time(nullptr);
+        std::error_code ec;
+        for (auto it = entries_.begin(); it != entries_.end();) {
+            if (it->second.fetched + ttl_ > now && fs::exists(json_path(it->first), ec)) { ++it; continue; }
+            fs::remove(json_path(it->first), ec);
+            it = entries_.erase(it);
+        }
+        if (lines == entries_.size()) return;
+        // rewrite without the stale and superseded lines
+        std::string tmp = index_path() + ".tmp";
+        std::ofstream out(tmp, std::ios::trunc);
+        for (auto &kv : entries_)
+            out << kv.first << "\t" << kv.second.fetched << "\t" << kv.second.info.bytes << "\t" << kv.second.info.duration << "\n";
+        out.close();
+        if (!out || !replace_file(tmp, index_path())) std::cerr << "[WARN] Failed to compact info cache index\n";
+    }
+
+    std::mutex m_;
+    bool loaded_ = false;
+    int ttl_ = 3600;
+    std::map<std::string, Entry> entries_;
+    int fd_ = -1;
 };
 
 // ---------- Lists Manager ----------
@@ -260,128 +1204,3626 @@ static std::vector<std::string> list_names() {
     std::vector<std::string> names;
     ensure_dir(lists_dir());
     for (auto &p : fs::directory_iterator(lists_dir())) {
-        if (p.is_regular_file()) {
-            std::string n = p.path().filename().string();
-            if (n.size() > 4 && n.substr(n.size()-4)==".txt") n = n.substr(0, n.size()-4);
-            names.push_back(n);
-        }
+        if (!p.is_regular_file() || p.path().extension() != ".txt") continue;   // skip journals / temp files
+        names.push_back(p.path().stem().string());
     }
     std::sort(names.begin(), names.end());
     return names;
 }
 
 static std::string list_path(const std::string &name) { return lists_dir() + "/" + name + ".txt"; }
+// Append-only completion journal kept next to the list: one "D <url>" line per
+// finished download, fsync'd as it is written.
+static std::string journal_path(const std::string &name) { return lists_dir() + "/" + name + ".journal"; }
+
+// Exclusive lock on one list, internals/lists/<name>.lock, taken by every
+// instance around anything that writes the list file, its journal or its
+// leases, so several processes (or hosts sharing internals/ over NFS) can
+// work on one list. fcntl() locks belong to the process, so threads of one
+// process also serialize on a mutex of that list; the lock is reentrant
+// within a thread. The only nesting is a list, then its quarantine list.
+class ListLock {
+public:
+    explicit ListLock(const std::string &name) {
+        {
+            std::lock_guard<std::mutex> lk(guard());
+            auto &p = held()[name];
+            if (!p) p.reset(new Held);
+            h_ = p.get();
+        }
+        h_->m.lock();
+        if (h_->depth++ > 0) return;
+        h_->fd = fd_lock(lists_dir() + "/" + name + ".lock");
+        static std::atomic<bool> warned{false};
+        if (h_->fd < 0 && !warned.exchange(true))
+            std::cerr << "[WARN] Cannot lock list '" << name << "'; other instances may download the same URLs\n";
+    }
+    ~ListLock() {
+        if (--h_->depth == 0 && h_->fd >= 0) { fd_unlock(h_->fd); h_->fd = -1; }
+        h_->m.unlock();
+    }
+    ListLock(const ListLock&) = delete;
+    ListLock &operator=(const ListLock&) = delete;
+
+private:
+    struct Held { std::recursive_mutex m; int fd = -1, depth = 0; };   // fd, depth guarded by m
+    static std::mutex &guard() { static std::mutex m; return m; }
+    // one per list name seen, kept for the life of the process
+    static std::map<std::string, std::unique_ptr<Held>> &held() { static std::map<std::string, std::unique_ptr<Held>> h; return h; }   // guarded by guard()
+    Held *h_;
+};
+
+// A journal line [b, e), as next_entry() trims it, that records a finished
+// URL: "D <url>". ListCursor and ListIndex must agree on this.
+static bool is_done_record(const char *b, const char *e) { return e - b > 2 && b[0] == 'D' && b[1] == ' '; }
+
+// Streams a list's entries straight from the mapped file. Each journal record
+// cancels one occurrence of its URL.
+class ListCursor {
+public:
+    explicit ListCursor(const std::string &name) : file_(list_path(name)), p_(file_.begin()) {
+        MappedFile j(journal_path(name));
+        const char *p = j.begin(), *b, *e;
+        while (next_entry(p, j.end(), b, e)) {
+            if (!is_done_record(b, e)) continue;
+            for (b += 2; b < e && std::isspace((unsigned char)*b); ++b) {}
+            done_[std::string(b, e)]++;
+        }
+    }
+
+    bool next(std::string &url) {
+        const char *b, *e;
+        while (next_entry(p_, file_.end(), b, e)) {
+            url.assign(b, e);
+            if (!done_.empty()) {
+                auto it = done_.find(url);
+                if (it != done_.end() && it->second > 0) { it->second--; continue; }
+            }
+            return true;
+        }
+        return false;
+    }
+
+private:
+    MappedFile file_;
+    const char *p_;
+    std::unordered_map<std::string,int> done_;
+};
 
 static std::vector<std::string> load_list(const std::string &name) {
-    std::vector<std::string> v; std::ifstream f(list_path(name)); if (!f) return v;
-    std::string line;
-    while (std::getline(f,line)) { line = trim(line); if (line.empty() || line[0]=='#') continue; v.push_back(line); }
+    std::vector<std::string> v;
+    ListCursor c(name);
+    for (std::string u; c.next(u);) v.push_back(u);
     return v;
 }
+
+// Writes the list to a temp file, fsyncs it and renames it over the old one.
 static bool save_list(const std::string &name, const std::vector<std::string> &v) {
-    std::ofstream f(list_path(name)); if (!f) return false; for (auto &s : v) f << s << "\n"; return true;
+    ListLock lock(name);
+    std::string tmp = list_path(name) + ".tmp";
+    FILE *f = std::fopen(tmp.c_str(), "wb"); if (!f) return false;
+    bool ok = true;
+    for (auto &s : v) ok = ok && std::fwrite(s.data(), 1, s.size(), f) == s.size() && std::fputc('\n', f) != EOF;
+    ok = ok && std::fflush(f) == 0 && fd_sync(fileno(f)) == 0;
+    ok = (std::fclose(f) == 0) && ok;
+    if (!ok || !replace_file(tmp, list_path(name))) { std::remove(tmp.c_str()); return false; }
+    return true;
 }
 static bool append_to_list(const std::string &name, const std::string &url) {
+    ListLock lock(name);
     std::ofstream f(list_path(name), std::ios::app); if (!f) return false; f << url << "\n"; return true;
 }
-static bool delete_list(const std::string &name) { try { fs::remove(list_path(name)); return true; } catch(...) { return false; } }
+// Streams a URL file into a list with one append handle, skipping URLs that
+// are already listed, already downloaded or repeated within the file.
+struct ImportStats { size_t added = 0, listed = 0, archived = 0, repeated = 0; };
+static bool import_urls(const std::string &name, const std::string &file, ImportStats &st) {
+    std::ifstream in(file);
+    if (!in) return false;
+    ListLock lock(name);
+    std::unordered_set<uint64_t> listed, seen;
+    ListCursor cur(name);
+    for (std::string u; cur.next(u);) listed.insert(hash64(canonical_key(u)));
+    std::vector<char> outbuf(1 << 20);   // declared before out: outlives it
+    std::ofstream out;
+    out.rdbuf()->pubsetbuf(outbuf.data(), (std::streamsize)outbuf.size());
+    out.open(list_path(name), std::ios::app);
+    if (!out) return false;
+    auto &archive = DownloadArchive::instance();
+    std::string line;
+    while (std::getline(in, line)) {
+        line = trim(line);
+        if (line.empty() || line[0]=='#') continue;
+        std::string key = canonical_key(line);
+        uint64_t h = hash64(key);
+        if (listed.count(h)) { st.listed++; continue; }
+        if (!seen.insert(h).second) { st.repeated++; continue; }
+        if (archive.contains(key)) { st.archived++; continue; }
+        out << line << '\n';
+        st.added++;
+    }
+    out.flush();
+    return (bool)out;
+}
 
-// ---------- Progress executor ----------
-static int exec_with_progress(const std::string &cmd) {
-    FILE* pipe = popen((cmd + " 2>&1").c_str(), "r");
-    if (!pipe) { std::cerr << "[ERR] failed to run command\n"; return -1; }
+// How the downloads of one list are fetched, from the optional
+// internals/lists/<name>.profile (key=value like config.cfg, all optional):
+//   concurrent_fragments=8     HLS/DASH fragments fetched in parallel, or
+//                              "auto" to let FragmentTuner pick the count
+//   http_chunk_size=10M        ranged requests of this size, which gets round
+//                              per-connection throttling on some sites
+//   buffer_size=1M             download buffer
+//   downloader=aria2c          external downloader (--downloader)
+//   downloader_args=aria2c:-x 8 -s 8   its arguments (--downloader-args)
+struct DownloadProfile {
+    int fragments = 0;              // 0 = yt-dlp's default (one at a time)
+    bool autoFragments = false;
+    uint64_t chunkSize = 0, bufferSize = 0;
+    std::string downloader, downloaderArgs;
+};
 
+static std::string profile_path(const std::string &name) { return lists_dir() + "/" + name + ".profile"; }
+
+static DownloadProfile load_profile(const std::string &name) {
+    DownloadProfile p;
+    std::ifstream f(profile_path(name));
     std::string line;
-    char buf[512];
-    std::regex percentRe(R"(\[download\].*?([0-9]{1,3}(?:\.[0-9])?)%)");
-    std::regex etaRe(R"(ETA\s+([0-9]{2}:[0-9]{2}:[0-9]{2}|[0-9]{2}:[0-9]{2}))");
-    std::smatch m1, m2;
-    std::string lastProgress;
-    const char *spinner = "|/-\\";
-    int spin = 0;
-
-    auto lastPrint = std::chrono::steady_clock::now();
-    while (fgets(buf, sizeof(buf), pipe) != nullptr) {
-        line = buf;
-        if (std::regex_search(line, m1, percentRe)) {
-            std::string pct = m1[1].str();
-            std::string etaStr;
-            if (std::regex_search(line, m2, etaRe)) etaStr = m2[1].str();
-            lastProgress = "[DOWNLOAD] " + pct + "%";
-            if (!etaStr.empty()) lastProgress += " ETA " + etaStr;
-            std::cout << "\r" << lastProgress << "    " << std::flush;
-            lastPrint = std::chrono::steady_clock::now();
-        } else {
-            auto now = std::chrono::steady_clock::now();
-            if (std::chrono::duration_cast<std::chrono::milliseconds>(now - lastPrint).count() > 300) {
-                std::string out = "[RUNNING] ";
-                if (!lastProgress.empty()) out = lastProgress + " ";
-                std::cout << "\r" << out << spinner[spin % 4] << "    " << std::flush;
-                spin++;
-                lastPrint = now;
-            }
-        }
-        if (line.rfind("[info]",0)==0 || line.rfind("[ffmpeg]",0)==0 || line.rfind("ERROR",0)==0) {
-            std::cout << "\n" << line << std::flush;
+    while (std::getline(f, line)) {
+        line = trim(line);
+        if (line.rfind("concurrent_fragments=",0)==0) {
+            std::string v = line.substr(21);
+            p.autoFragments = v == "auto";
+            p.fragments = p.autoFragments ? 0 : parse_int_clamped(v, 0, 0, 64);
         }
+        if (line.rfind("http_chunk_size=",0)==0) p.chunkSize = parse_rate(line.substr(16), 0);
+        if (line.rfind("buffer_size=",0)==0) p.bufferSize = parse_rate(line.substr(12), 0);
+        if (line.rfind("downloader=",0)==0) p.downloader = line.substr(11);
+        if (line.rfind("downloader_args=",0)==0) p.downloaderArgs = line.substr(16);
     }
+    return p;
+}
+static bool save_profile(const std::string &name, const DownloadProfile &p) {
+    std::ofstream f(profile_path(name), std::ios::trunc);
+    f << "concurrent_fragments=" << (p.autoFragments ? "auto" : std::to_string(p.fragments)) << "\n";
+    f << "http_chunk_size=" << format_rate(p.chunkSize) << "\n";
+    f << "buffer_size=" << format_rate(p.bufferSize) << "\n";
+    f << "downloader=" << p.downloader << "\n";
+    f << "downloader_args=" << p.downloaderArgs << "\n";
+    return (bool)f;
+}
 
-    int rc = pclose(pipe);
-    std::cout << "\n";
-    return rc;
+static bool delete_list(const std::string &name) {
+    try {
+        ListLock lock(name);
+        for (auto &p : {journal_path(name), profile_path(name), lists_dir() + "/" + name + ".leases", list_path(name)}) fs::remove(p);
+        return true;
+    } catch(...) { return false; }
 }
 
-// ---------- Build command ----------
-static bool build_yt_dlp_cmd(const Config &cfg, const std::string &ytdlp, const std::string &ffmpeg, const std::string &url, std::string &out_cmd) {
-    out_cmd.clear();
-    out_cmd += "\"" + ytdlp + "\" ";
-    if (!ffmpeg.empty()) out_cmd += "--ffmpeg-location \"internals\" ";
-    if (cfg.mode == "audio") {
-        if (cfg.targetFormat == "mp3") out_cmd += "-x --audio-format mp3 ";
-        else out_cmd += "-x ";
-    } else {
-        if (cfg.quality == "best") out_cmd += "-f \"bestvideo+bestaudio/best\" ";
-        else out_cmd += "-f \"bestvideo[height<=" + cfg.quality + "]+bestaudio/best[height<=" + cfg.quality + "]\" ";
-        if (cfg.targetFormat == "mp4") {
-            if (!ffmpeg.empty()) out_cmd += "--recode-video mp4 ";
-            else out_cmd += "--merge-output-format mp4 ";
-        }
-    }
-    out_cmd += "-o \"downloads/%(title)s.%(ext)s\" ";
-    out_cmd += "--no-warnings --ignore-errors --no-playlist --restrict-filenames ";
-    out_cmd += "\"" + url + "\"";
+struct ListInfo {
+    size_t count = 0;   // entries in the list file
+    size_t done = 0;    // journal records not yet folded into it
+    size_t pending() const { return done < count ? count - done : 0; }
+};
+
+// Per-list counts cached in internals/lists/.index, one tab-separated line per
+// list: name, count, done, then mtime and size of the list file and of its
+// journal. An entry is trusted while both files keep that mtime and size;
+// otherwise the list is recounted with a line scan of the mapped files.
+class ListIndex {
+public:
+    static ListIndex &instance() { static ListIndex i; return i; }
+
+    std::vector<ListInfo> lookup(const std::vector<std::string> &names) {
+        std::lock_guard<std::mutex> lk(m_);
+        load();
+        std::vector<ListInfo> out;
+        bool changed = false;
+        for (auto &n : names) {
+            Entry cur;
+            stamp(list_path(n), cur.mtime, cur.size);
+            stamp(journal_path(n), cur.jmtime, cur.jsize);
+            auto it = entries_.find(n);
+            if (it == entries_.end() || !it->second.same_files(cur)) {
+                cur.info = count(n);
+                it = entries_.insert_or_assign(n, cur).first;
+                changed = true;
+            }
+            out.push_back(it->second.info);
+        }
+        if (changed) save();
+        return out;
+    }
+
+private:
+    struct Entry {
+        ListInfo info;
+        int64_t mtime = 0, jmtime = 0;
+        uint64_t size = 0, jsize = 0;
+        bool same_files(const Entry &o) const { return mtime == o.mtime && size == o.size && jmtime == o.jmtime && jsize == o.jsize; }
+    };
+
+    static std::string path() { return lists_dir() + "/.index"; }
+
+    static void stamp(const std::string &p, int64_t &mtime, uint64_t &size) {
+        std::error_code ec;
+        auto t = fs::last_write_time(p, ec);
+        mtime = ec ? 0 : (int64_t)t.time_since_epoch().count();
+        size = fs::file_size(p, ec);
+        if (ec) size = 0;
+    }
+
+    static ListInfo count(const std::string &name) {
+        ListInfo info;
+        const char *b, *e;
+        MappedFile f(list_path(name));
+        for (const char *p = f.begin(); next_entry(p, f.end(), b, e);) info.count++;
+        MappedFile j(journal_path(name));
+        for (const char *p = j.begin(); next_entry(p, j.end(), b, e);) info.done += is_done_record(b, e);
+        return info;
+    }
+
+    void load() {
+        if (loaded_) return;
+        loaded_ = true;
+        std::ifstream f(path());
+        std::string line;
+        while (std::getline(f, line)) {
+            std::vector<std::string> col;
+            size_t a = 0;
+            for (size_t t; (t = line.find('\t', a)) != std::string::npos; a = t + 1) col.push_back(line.substr(a, t - a));
+            col.push_back(line.substr(a));
+            if (col.size() != 7) continue;
+            Entry en;
+            try {
+                en.info.count = std::stoull(col[1]);
+                en.info.done = std::stoull(col[2]);
+                en.mtime = std::stoll(col[3]);
+                en.size = std::stoull(col[4]);
+                en.jmtime = std::stoll(col[5]);
+                en.jsize = std::stoull(col[6]);
+            } catch (...) { continue; }
+            entries_[col[0]] = en;
+        }
+    }
+
+    // Rewrites the index, dropping lists that no longer exist.
+    void save() {
+        std::string out;
+        for (auto it = entries_.begin(); it != entries_.end();) {
+            if (!file_exists(list_path(it->first))) { it = entries_.erase(it); continue; }
+            auto &en = it->second;
+            out += it->first + "\t" + std::to_string(en.info.count) + "\t" + std::to_string(en.info.done) + "\t"
+                 + std::to_string(en.mtime) + "\t" + std::to_string(en.size) + "\t"
+                 + std::to_string(en.jmtime) + "\t" + std::to_string(en.jsize) + "\n";
+            ++it;
+        }
+        std::string tmp = path() + ".tmp";
+        {
+            std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+            if (!(f << out)) return;
+        }
+        if (!replace_file(tmp, path())) std::remove(tmp.c_str());
+    }
+
+    ListIndex() = default;
+    std::mutex m_;
+    bool loaded_ = false;
+    std::map<std::string, Entry> entries_;
+};
+
+static std::vector<ListInfo> list_infos(const std::vector<std::string> &names) { return ListIndex::instance().lookup(names); }
+static ListInfo list_info(const std::string &name) { return list_infos({name})[0]; }
+
+// Where a list entry stands. A finished entry leaves the list through a "D"
+// record; the other states are "S" records in the same journal, the last one
+// per URL winning:
+//   S <q|r|p|f> <attempts> <next retry, unix seconds> <error class> <url>
+enum class UrlState : char { Queued = 'q', Running = 'r', Postprocessing = 'p', Failed = 'f' };
+struct UrlRecord {
+    UrlState state = UrlState::Queued;
+    int attempts = 0;          // failed attempts so far
+    int64_t nextRetry = 0;     // Failed: not eligible before this time
+    std::string error = "-";   // class of the last failure
+};
+
+// Quarantined URLs of list "x" are moved to the list "x-quarantine".
+static std::string quarantine_list(const std::string &name) { return name + "-quarantine"; }
+
+// Open handle on a list's completion journal for the duration of a run.
+// Safe to call from several download workers at once, and from several
+// instances sharing the list: writes happen under its ListLock.
+class ListJournal {
+public:
+    explicit ListJournal(const std::string &name) : name_(name) {
+        load_states();
+        fd_ = fd_open_append(journal_path(name));
+        if (fd_ < 0) std::cerr << "[WARN] Cannot open journal for '" << name << "', progress will only be saved at the end\n";
+    }
+    ~ListJournal() { if (fd_ >= 0) fd_close(fd_); }
+    ListJournal(const ListJournal&) = delete;
+    ListJournal &operator=(const ListJournal&) = delete;
+
+    // Re-reads the states, picking up what other instances recorded.
+    void reload() {
+        ListLock lock(name_);
+        std::lock_guard<std::mutex> lk(m_);
+        load_states();
+    }
+
+    // Durably records one finished URL.
+    bool record_done(const std::string &url) { return record_done_all({url}); }
+
+    // Same for many URLs, with a single write + fsync.
+    bool record_done_all(const std::vector<std::string> &urls) {
+        ListLock lock(name_);
+        std::lock_guard<std::mutex> lk(m_);
+        if (fd_ < 0) return false;
+        if (urls.empty()) return true;
+        std::string rec;
+        for (auto &u : urls) { rec += "D " + u + "\n"; states_.erase(u); }
+        if (!fd_write(fd_, rec)) return false;
+        fd_sync(fd_);
+        pending_ += urls.size();
+        return true;
+    }
+
+    // State of an entry that is still listed; a fresh Queued record if none.
+    UrlRecord state(const std::string &url) {
+        std::lock_guard<std::mutex> lk(m_);
+        auto it = states_.find(url);
+        return it == states_.end() ? UrlRecord() : it->second;
+    }
+
+    // Records a state change. Not fsync'd: losing one only means the entry
+    // is retried a little early.
+    bool set_state(const std::string &url, const UrlRecord &r) {
+        ListLock lock(name_);
+        std::lock_guard<std::mutex> lk(m_);
+        if (r.state == UrlState::Queued && r.attempts == 0) states_.erase(url);
+        else states_[url] = r;
+        return fd_ >= 0 && fd_write(fd_, state_record(url, r));
+    }
+
+    // Moves a URL to the quarantine list, with its error class as a comment,
+    // and takes it off this list.
+    bool quarantine(const std::string &url, const std::string &cls) {
+        char stamp[32];
+        std::time_t now = std::time(nullptr);
+        std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+        {
+            ListLock lock(quarantine_list(name_));
+            std::ofstream q(list_path(quarantine_list(name_)), std::ios::app);
+            if (!(q << "# " << cls << " " << stamp << "\n" << url << "\n")) return false;
+        }
+        return record_done(url);
+    }
+
+    // Records written since the last compaction.
+    size_t pending() { std::lock_guard<std::mutex> lk(m_); return pending_; }
+
+    // Folds the journal into the list file (atomic rename), then empties it
+    // except for the states of the entries still listed, including those
+    // other instances recorded. URLs appended to the list meanwhile are kept.
+    bool compact() {
+        ListLock lock(name_);
+        std::lock_guard<std::mutex> lk(m_);
+        load_states();
+        if (!save_list(name_, load_list(name_))) return false;
+        if (fd_ >= 0 && fd_truncate(fd_) != 0) return false;
+        if (fd_ < 0) { try { fs::remove(journal_path(name_)); } catch(...) {} }
+        else if (!states_.empty()) {
+            std::string rec;
+            for (auto &kv : states_) rec += state_record(kv.first, kv.second);
+            if (!fd_write(fd_, rec)) return false;
+            fd_sync(fd_);
+        }
+        pending_ = 0;
+        return true;
+    }
+
+private:
+    static std::string state_record(const std::string &url, const UrlRecord &r) {
+        return std::string("S ") + (char)r.state + " " + std::to_string(r.attempts) + " " + std::to_string(r.nextRetry)
+             + " " + (r.error.empty() ? "-" : r.error) + " " + url + "\n";
+    }
+
+    // Replays the journal file into states_; caller holds m_ (or is the ctor).
+    void load_states() {
+        states_.clear();
+        MappedFile j(journal_path(name_));
+        const char *p = j.begin(), *b, *e;
+        while (next_entry(p, j.end(), b, e)) {
+            std::string line(b, e);
+            if (starts_with(line, "D ")) { states_.erase(trim(line.substr(2))); continue; }
+            char st;
+            int attempts;
+            long long next;
+            char cls[32];
+            int n = 0;
+            if (std::sscanf(line.c_str(), "S %c %d %lld %31s %n", &st, &attempts, &next, cls, &n) != 4
+                || n == 0 || (size_t)n >= line.size() || !std::strchr("qrpf", st)) continue;
+            UrlRecord r;
+            r.state = (UrlState)st;
+            r.attempts = attempts;
+            r.nextRetry = next;
+            r.error = cls;
+            // a run that died left these behind, or another instance's lease
+            // covers them (see ListLeases); either way they are queued again
+            if (r.state == UrlState::Running || r.state == UrlState::Postprocessing) r.state = UrlState::Queued;
+            states_[line.substr(n)] = r;
+        }
+    }
+
+    std::string name_;
+    int fd_ = -1;
+    size_t pending_ = 0;
+    std::unordered_map<std::string, UrlRecord> states_;   // entries not in the Queued/0 state
+    std::mutex m_;
+};
+
+// ---------- Progress executor ----------
+// Serializes log lines coming from concurrent download workers.
+static std::mutex g_out_mutex;
+// Set while a ProgressRenderer owns the terminal: log lines are queued for it
+// to print above its display. Guarded by g_out_mutex.
+static std::vector<std::pair<bool, std::string>> *g_out_queue = nullptr;
+
+// Prints one log line (to stderr when err is set) without tearing the
+// progress display.
+static void log_line(const std::string &line, bool err = false) {
+    std::lock_guard<std::mutex> lk(g_out_mutex);
+    if (g_out_queue) { g_out_queue->push_back({err, line}); return; }
+    (err ? std::cerr : std::cout) << (stdout_is_terminal() ? line_reset() : "") << line << "\n" << std::flush;
+}
+
+// Single-writer seqlock around a trivially copyable value: the writer never
+// waits, readers retry only if they overlapped a store. The payload is kept
+// in relaxed atomic words so concurrent reads are well defined.
+template <class T>
+class SeqSlot {
+public:
+    SeqSlot() { store(T()); }
+
+    void store(const T &v) {
+        uint64_t buf[W] = {};
+        std::memcpy(buf, &v, sizeof(T));
+        uint32_t s = seq_.load(std::memory_order_relaxed);
+        seq_.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < W; ++i) words_[i].store(buf[i], std::memory_order_relaxed);
+        seq_.store(s + 2, std::memory_order_release);
+    }
+
+    T load() const {
+        uint64_t buf[W];
+        uint32_t s1, s2;
+        do {
+            s1 = seq_.load(std::memory_order_acquire);
+            for (size_t i = 0; i < W; ++i) buf[i] = words_[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            s2 = seq_.load(std::memory_order_relaxed);
+        } while ((s1 & 1) || s1 != s2);
+        T v;
+        std::memcpy(&v, buf, sizeof(T));
+        return v;
+    }
+
+private:
+    static constexpr size_t W = (sizeof(T) + 7) / 8;
+    std::atomic<uint32_t> seq_{0};
+    std::atomic<uint64_t> words_[W] = {};
+};
+
+// yt-dlp is started with --progress-template so every update arrives as one
+// fixed record instead of free-form text:
+//   [SHP] <downloaded_bytes> <total_bytes> <speed> <eta> <status> <file>
+// Missing values are printed by yt-dlp as "NA". The file is the one the
+// stream is downloaded to (its .part while running); with
+// --restrict-filenames it holds no spaces.
+static const char PROGRESS_TAG[] = "[SHP] ";
+static const char PROGRESS_TEMPLATE[] =
+    "download:[SHP] %(progress.downloaded_bytes)s %(progress.total_bytes,progress.total_bytes_estimate)s "
+    "%(progress.speed)s %(progress.eta)s %(progress.status)s %(progress.filename)s";
+
+struct ProgressRecord {
+    uint64_t downloaded = 0;
+    uint64_t total = 0;     // 0 = unknown
+    double speed = 0;       // bytes/s, 0 = unknown
+    int64_t eta = -1;       // seconds, -1 = unknown
+    char status = '?';      // first letter of yt-dlp's status: d(ownloading), f(inished), e(rror)
+};
+
+// Reads one numeric field ("NA" or a decimal with optional fraction) and
+// advances p past it. Returns false when the field is not a number.
+static bool scan_number(const char *&p, const char *end, double &out) {
+    while (p < end && *p == ' ') ++p;
+    const char *start = p;
+    double v = 0;
+    while (p < end && *p >= '0' && *p <= '9') v = v * 10 + (*p++ - '0');
+    if (p < end && *p == '.') {
+        double scale = 0.1;
+        for (++p; p < end && *p >= '0' && *p <= '9'; ++p, scale *= 0.1) v += (*p - '0') * scale;
+    }
+    bool ok = p > start;
+    while (p < end && *p != ' ') ++p;   // skip "NA" or anything unexpected
+    out = v;
+    return ok;
+}
+
+// Allocation-free parser for one PROGRESS_TEMPLATE line.
+static bool parse_progress_record(const char *line, size_t n, ProgressRecord &r) {
+    const size_t tagLen = sizeof(PROGRESS_TAG) - 1;
+    if (n < tagLen || std::memcmp(line, PROGRESS_TAG, tagLen) != 0) return false;
+    const char *p = line + tagLen, *end = line + n;
+    double v;
+    r = ProgressRecord();
+    if (scan_number(p, end, v)) r.downloaded = (uint64_t)v;
+    if (scan_number(p, end, v)) r.total = (uint64_t)v;
+    if (scan_number(p, end, v)) r.speed = v;
+    if (scan_number(p, end, v)) r.eta = (int64_t)v;
+    while (p < end && *p == ' ') ++p;
+    if (p < end) r.status = *p;
+    return true;
+}
+
+// The file field of a line parse_progress_record() accepted, as [b, e);
+// empty when yt-dlp printed none.
+static void progress_record_file(const char *line, size_t n, const char *&b, const char *&e) {
+    const char *p = line + sizeof(PROGRESS_TAG) - 1, *end = line + n;
+    for (int field = 0; field < 5 && p < end; ++field) {
+        while (p < end && *p == ' ') ++p;
+        while (p < end && *p != ' ') ++p;
+    }
+    while (p < end && *p == ' ') ++p;
+    while (end > p && std::isspace((unsigned char)end[-1])) --end;
+    if (end - p == 2 && p[0] == 'N' && p[1] == 'A') p = end;
+    b = p; e = end;
+}
+
+static int progress_permille(const ProgressRecord &r) {
+    if (r.status == 'f') return 1000;
+    if (r.total == 0) return -1;
+    return (int)std::min<uint64_t>(1000, r.downloaded * 1000 / r.total);
+}
+
+// "[DOWNLOAD] 45.3% ETA 00:01:23 at 2.4MiB/s" into a caller-provided buffer.
+static void format_progress(const ProgressRecord &r, char *buf, size_t cap) {
+    int pm = progress_permille(r);
+    int len = pm < 0 ? std::snprintf(buf, cap, "[DOWNLOAD] %.1fMiB", r.downloaded / 1048576.0)
+                     : std::snprintf(buf, cap, "[DOWNLOAD] %d.%d%%", pm / 10, pm % 10);
+    if (len < 0 || (size_t)len >= cap) return;
+    if (r.eta >= 0) {
+        int e = std::snprintf(buf + len, cap - len, " ETA %02lld:%02lld:%02lld",
+                              (long long)(r.eta / 3600), (long long)(r.eta / 60 % 60), (long long)(r.eta % 60));
+        if (e < 0 || (size_t)(len += e) >= cap) return;
+    }
+    if (r.speed > 0) std::snprintf(buf + len, cap - len, " at %.1fMiB/s", r.speed / 1048576.0);
+}
+
+// What a job last published about itself for the progress display.
+struct ProgressSnapshot {
+    ProgressRecord rec;       // latest record of the current item
+    bool hasRecord = false;   // false until the item's first record
+    int permille = -1;        // download progress, -1 = nothing parsed yet
+    char label[96] = "";      // URL, "+N more" for batches
+};
+
+// Live state of one pool slot. A job given a slot reports into it instead of
+// drawing its own progress line.
+struct JobStatus {
+    std::string tag;                  // e.g. "#3", prefixed to the job's log lines
+    std::atomic<bool> busy{false};
+    std::atomic<uint64_t> bytes{0};   // downloaded by every job that used this slot
+    std::atomic<int> throttled{0};    // errors that look like rate limiting, see is_throttle_error
+    ProgressSnapshot draft;           // loop thread only
+    SeqSlot<ProgressSnapshot> shown;  // draft as last published, readable from any thread
+
+    void publish() { shown.store(draft); }
+};
+
+// Download runs add --print so yt-dlp announces every item it finished, where
+// it put the file, the codecs it holds (yt-dlp's names, "none" for a missing
+// stream), its id, duration (0 when unknown) and title:
+//   [SHDONE] <url as given to yt-dlp>\t<final file path>\t<vcodec>\t<acodec>\t<id>\t<seconds>\t<title>
+// The title goes last: it is the one field that may hold a tab.
+static const char DONE_TAG[] = "[SHDONE] ";
+static const char DONE_TEMPLATE[] = "after_move:[SHDONE] %(original_url)s\t%(filepath)s\t%(vcodec)s\t%(acodec)s\t%(id)s\t%(duration|0)s\t%(title)s";
+
+// Prefetch runs announce every item they resolved, with the name its info
+// JSON got in the run's directory and the size and duration, 0 when unknown:
+//   [SHMETA] <url>\t<extractor>-<id>\t<bytes>\t<seconds>
+static const char META_TAG[] = "[SHMETA] ";
+static const char META_TEMPLATE[] = "[SHMETA] %(original_url)s\t%(extractor_key)s-%(id)s\t%(filesize,filesize_approx|0)s\t%(duration|0)s";
+
+// Where the time of one item inside a job went, as seen in its output: from
+// start (job launch or the previous item's marker) to the first progress
+// record is extraction, from there to end is the download.
+struct ItemTiming {
+    std::chrono::steady_clock::time_point start, firstProgress, end;
+    bool started = false;   // a progress record was seen
+    uint64_t bytes = 0;
+    double peakBps = 0;
+};
+
+// One DONE_TAG line; the fields are empty when yt-dlp did not print them.
+struct DoneItem {
+    std::string url, file, vcodec, acodec, id, title;
+    double duration = 0;
+    ItemTiming timing;
+};
+using DoneItems = std::vector<DoneItem>;
+
+// yt-dlp errors that mean the site or the link is overloaded, not that the
+// item itself is bad.
+static bool is_throttle_error(const std::string &line) {
+    for (const char *s : {"HTTP Error 429", "Too Many Requests", "HTTP Error 503", "timed out", "Connection reset"})
+        if (line.find(s) != std::string::npos) return true;
+    return false;
+}
+
+// Why an attempt failed, from one of its ERROR lines. yt-dlp's wording varies
+// by site, so this only looks for the common phrases.
+static std::string error_class(const std::string &line) {
+    static const struct { const char *needle, *cls; } table[] = {
+        {"video unavailable", "unavailable"}, {"is unavailable", "unavailable"}, {"has been removed", "unavailable"},
+        {"does not exist", "unavailable"}, {"http error 404", "unavailable"}, {"http error 410", "unavailable"},
+        {"account associated with this video has been terminated", "unavailable"},
+        {"private video", "private"}, {"video is private", "private"}, {"members-only", "private"},
+        {"sign in", "private"}, {"login required", "private"},
+        {"in your country", "geo"}, {"geo restrict", "geo"}, {"geo-restrict", "geo"}, {"geo_restrict", "geo"},
+        {"unsupported url", "unsupported"},
+        {"unable to download webpage", "network"}, {"name or service not known", "network"}, {"failed to resolve", "network"},
+        {"temporary failure in name resolution", "network"}, {"connection refused", "network"}, {"network is unreachable", "network"},
+    };
+    std::string low(line);
+    for (auto &c : low) c = (char)std::tolower((unsigned char)c);
+    for (auto &t : table) if (low.find(t.needle) != std::string::npos) return t.cls;
+    return is_throttle_error(line) ? "throttled" : "error";
+}
+
+// Failures that will not go away by retrying.
+static bool is_permanent_error(const std::string &cls) {
+    return cls == "unavailable" || cls == "private" || cls == "geo" || cls == "unsupported";
+}
+
+// Interprets one job's yt-dlp output line by line: progress records, done
+// markers and errors. Byte counts, throttling errors and progress always go to
+// the pool slot, where the renderer picks them up; nothing here writes to the
+// terminal directly. With inlineProgress (the classic one-job view) yt-dlp's
+// [info] / [ffmpeg] lines are echoed too, otherwise only errors.
+class JobOutput {
+public:
+    JobOutput(JobStatus *status, bool inlineProgress, DoneItems *done)
+        : status_(status), inline_(inlineProgress), done_(done) {
+        item_.start = item_.end = activity_ = std::chrono::steady_clock::now();
+    }
+
+    void line(const std::string &line) {
+        if (parse_progress_record(line.data(), line.size(), rec_)) {
+            // a smaller count means the next file (format, item) has started
+            uint64_t delta = rec_.downloaded >= lastBytes_ ? rec_.downloaded - lastBytes_ : rec_.downloaded;
+            lastBytes_ = rec_.downloaded;
+            status_->bytes += delta;
+            item_.end = std::chrono::steady_clock::now();
+            if (delta) activity_ = item_.end;
+            const char *fb, *fe;
+            progress_record_file(line.data(), line.size(), fb, fe);
+            if (fb < fe && file_.compare(0, std::string::npos, fb, fe - fb) != 0) file_.assign(fb, fe);
+            if (!item_.started) { item_.started = true; item_.firstProgress = item_.end; }
+            item_.bytes += delta;
+            item_.peakBps = std::max(item_.peakBps, rec_.speed);
+            status_->draft.rec = rec_;
+            status_->draft.hasRecord = true;
+            status_->draft.permille = progress_permille(rec_);
+            status_->publish();
+            return;
+        }
+        activity_ = std::chrono::steady_clock::now();
+        if (done_ && starts_with(line, DONE_TAG)) {
+            std::string rest = trim(line.substr(sizeof(DONE_TAG) - 1));
+            std::string f[7];
+            for (size_t i = 0, a = 0; i < 7 && a <= rest.size(); ++i) {
+                size_t tab = i < 6 ? rest.find('\t', a) : std::string::npos;
+                if (tab == std::string::npos) tab = rest.size();
+                f[i] = rest.substr(a, tab - a);
+                if (f[i] == "NA") f[i].clear();
+                a = tab + 1;
+            }
+            item_.end = std::chrono::steady_clock::now();
+            DoneItem d;
+            d.url = f[0]; d.file = f[1]; d.vcodec = f[2]; d.acodec = f[3]; d.id = f[4]; d.title = f[6];
+            d.duration = std::atof(f[5].c_str());
+            d.timing = item_;
+            done_->push_back(std::move(d));
+            item_ = ItemTiming();
+            item_.start = item_.end = done_->back().timing.end;
+            lastBytes_ = 0;
+            status_->draft.hasRecord = false;
+            status_->draft.permille = -1;
+            status_->publish();
+            return;
+        }
+        bool error = starts_with(line, "ERROR");
+        if (error) {
+            if (is_throttle_error(line)) status_->throttled++;
+            if (errors_.size() < 64) errors_.push_back(trim(line));
+        }
+        if (!inline_) { if (error) log_line("[" + status_->tag + "] " + trim(line)); }
+        else if (error || starts_with(line, "[info]") || starts_with(line, "[ffmpeg]")) log_line(trim(line));
+    }
+
+    // In the one-job view the last progress line stays in the scrollback.
+    void finish() {
+        item_.end = std::chrono::steady_clock::now();
+        if (inline_ && status_->draft.hasRecord) {
+            char buf[128];
+            format_progress(status_->draft.rec, buf, sizeof(buf));
+            log_line(buf);
+        }
+    }
+
+    // The item still open when the job ended: the only one of a single-URL
+    // job without markers.
+    const ItemTiming &current() const { return item_; }
+
+    // ERROR lines seen so far (the first 64).
+    const std::vector<std::string> &errors() const { return errors_; }
+
+    // Last time bytes moved or yt-dlp printed anything but a progress record
+    // (extraction, merging, retries); progress records repeating the same
+    // count do not count.
+    std::chrono::steady_clock::time_point last_activity() const { return activity_; }
+
+    // File the latest progress record named, "" before the first one.
+    const std::string &file() const { return file_; }
+
+private:
+    JobStatus *status_;
+    bool inline_;
+    DoneItems *done_;
+    ProgressRecord rec_;
+    uint64_t lastBytes_ = 0;
+    ItemTiming item_;
+    std::chrono::steady_clock::time_point activity_;
+    std::string file_;
+    std::vector<std::string> errors_;
+};
+
+// ---------- Build command ----------
+// Format the transcode stage converts finished downloads to, or "" when
+// yt-dlp's output is final. Converting needs ffmpeg.
+static std::string transcode_target(const Config &cfg, const std::string &ffmpeg) {
+    if (ffmpeg.empty()) return "";
+    if (cfg.mode == "audio") return cfg.targetFormat == "mp3" ? "mp3" : "";
+    return cfg.targetFormat == "mp4" ? "mp4" : "";
+}
+
+// How the transcode stage turns one finished download into the target
+// format, cheapest first: not at all when it already has the target
+// extension; a stream copy into the new container when its codecs fit it; a
+// copy of the video with only the audio encoded again; a full re-encode
+// otherwise, and whenever the codecs are unknown.
+enum class Conversion { None, Remux, Audio, Recode };
+
+static const char *conversion_name(Conversion c) {
+    switch (c) {
+        case Conversion::None: return "none";
+        case Conversion::Remux: return "remux";
+        case Conversion::Audio: return "audio";
+        default: return "recode";
+    }
+}
+
+// codec is one of yt-dlp's codec names ("avc1.640028", "mp4a.40.2", "opus",
+// "none") starting with one of prefixes.
+static bool codec_is(const std::string &codec, std::initializer_list<const char*> prefixes) {
+    for (const char *p : prefixes) if (starts_with(codec, p)) return true;
+    return false;
+}
+
+static Conversion plan_conversion(const std::string &target, const std::string &file, const std::string &vcodec, const std::string &acodec) {
+    if (target.empty() || file.empty() || fs::path(file).extension().string() == "." + target) return Conversion::None;
+    if (vcodec.empty() || acodec.empty()) return Conversion::Recode;
+    if (target == "mp3") return codec_is(acodec, {"mp3"}) ? Conversion::Remux : Conversion::Recode;
+    bool video = codec_is(vcodec, {"avc1", "avc3", "h264", "hvc1", "hev1", "h265", "av01", "none"});
+    bool audio = codec_is(acodec, {"mp4a", "aac", "mp3", "ac-3", "ec-3", "none"});
+    return !video ? Conversion::Recode : audio ? Conversion::Remux : Conversion::Audio;
+}
+
+// Everything but the URL(s), as an argv for ProcessEngine::spawn. yt-dlp only
+// fetches and remuxes; re-encoding is left to the transcode stage, and with a
+// target format the selectors ask for streams that need none first (H.264 +
+// AAC for mp4, an mp3 stream for mp3). report adds the DONE_TAG markers
+// (--print implies --quiet, so --progress keeps the progress records coming).
+static void build_yt_dlp_opts(const Config &cfg, const std::string &ytdlp, const std::string &ffmpeg, bool report, std::vector<std::string> &args) {
+    args.clear();
+    args.push_back(ytdlp);
+    if (!ffmpeg.empty()) { args.push_back("--ffmpeg-location"); args.push_back("internals"); }
+    std::string target = transcode_target(cfg, ffmpeg);
+    if (cfg.mode == "audio") {
+        args.push_back("-x");
+        if (target == "mp3") { args.push_back("-f"); args.push_back("bestaudio[acodec=mp3]/bestaudio/best"); }
+    } else {
+        std::string h = cfg.quality == "best" ? "" : "[height<=" + cfg.quality + "]";
+        std::string sel = "bestvideo" + h + "+bestaudio/best" + h;
+        if (target == "mp4") sel = "bestvideo[vcodec^=avc1]" + h + "+bestaudio[acodec^=mp4a]/best[vcodec^=avc1][acodec^=mp4a]" + h + "/" + sel;
+        args.push_back("-f");
+        args.push_back(sel);
+        if (cfg.targetFormat == "mp4" && ffmpeg.empty()) { args.push_back("--merge-output-format"); args.push_back("mp4"); }
+    }
+    for (const char *a : {"-o", "downloads/%(title)s.%(ext)s", "--no-warnings", "--ignore-errors", "--no-playlist",
+                          "--restrict-filenames", "--newline", "--progress-template", PROGRESS_TEMPLATE})
+        args.push_back(a);
+    if (report) for (const char *a : {"--progress", "--print", DONE_TEMPLATE}) args.push_back(a);
+}
+
+static bool build_yt_dlp_cmd(const Config &cfg, const std::string &ytdlp, const std::string &ffmpeg, const std::string &url, std::vector<std::string> &args) {
+    build_yt_dlp_opts(cfg, ytdlp, ffmpeg, true, args);
+    args.push_back(url);
+    return true;
+}
+
+// Download from a prefetched info JSON instead of the URL: no extraction.
+static bool build_yt_dlp_info_cmd(const Config &cfg, const std::string &ytdlp, const std::string &ffmpeg, const std::string &infoJson, std::vector<std::string> &args) {
+    build_yt_dlp_opts(cfg, ytdlp, ffmpeg, true, args);
+    args.push_back("--load-info-json");
+    args.push_back(infoJson);
+    return true;
+}
+
+// Metadata only, for every URL in batchFile, with the info JSONs written to
+// tmpDir: same format selection as the download, so the info JSON names the
+// formats it will fetch.
+static bool build_yt_dlp_prefetch_cmd(const Config &cfg, const std::string &ytdlp, const std::string &ffmpeg, const std::string &batchFile,
+                                      const std::string &tmpDir, std::vector<std::string> &args) {
+    build_yt_dlp_opts(cfg, ytdlp, ffmpeg, false, args);
+    for (const char *a : {"--skip-download", "--no-simulate", "--write-info-json", "--no-write-playlist-metafiles",
+                          "--print", META_TEMPLATE, "-o"})
+        args.push_back(a);
+    args.push_back("infojson:" + tmpDir + "/%(extractor_key)s-%(id)s");
+    args.push_back("--batch-file");
+    args.push_back(batchFile);
+    return true;
+}
+
+// The entries of a playlist or channel, one URL per line, without resolving
+// them (--flat-playlist).
+static bool build_yt_dlp_expand_cmd(const std::string &ytdlp, const std::string &url, std::vector<std::string> &args) {
+    args = {ytdlp, "--flat-playlist", "--yes-playlist", "--no-warnings", "--ignore-errors", "--print", "%(url)s", url};
+    return true;
+}
+
+// One process for every URL in batchFile.
+static bool build_yt_dlp_batch_cmd(const Config &cfg, const std::string &ytdlp, const std::string &ffmpeg, const std::string &batchFile, std::vector<std::string> &args) {
+    build_yt_dlp_opts(cfg, ytdlp, ffmpeg, true, args);
+    args.push_back("--batch-file");
+    args.push_back(batchFile);
+    return true;
+}
+
+// A list's download profile as yt-dlp options, inserted right after the
+// program name; fragments is the count to use (the tuner's when "auto").
+static void add_profile_args(const DownloadProfile &p, int fragments, std::vector<std::string> &args) {
+    std::vector<std::string> opts;
+    if (fragments > 1) { opts.push_back("--concurrent-fragments"); opts.push_back(std::to_string(fragments)); }
+    if (p.chunkSize) { opts.push_back("--http-chunk-size"); opts.push_back(std::to_string(p.chunkSize)); }
+    if (p.bufferSize) { opts.push_back("--buffer-size"); opts.push_back(std::to_string(p.bufferSize)); }
+    if (!p.downloader.empty()) { opts.push_back("--downloader"); opts.push_back(p.downloader); }
+    if (!p.downloaderArgs.empty()) { opts.push_back("--downloader-args"); opts.push_back(p.downloaderArgs); }
+    args.insert(args.begin() + 1, opts.begin(), opts.end());
+}
+
+// ffmpeg conversion of one finished download into tmp as planned by
+// plan_conversion (a re-encode uses the codec defaults of yt-dlp's
+// --recode-video / --audio-format); the caller renames tmp into place.
+static void build_transcode_cmd(const std::string &ffmpeg, const std::string &target, Conversion how, const std::string &in, const std::string &tmp, std::vector<std::string> &args) {
+    args = {ffmpeg, "-hide_banner", "-nostdin", "-loglevel", "error", "-y", "-i", in};
+    if (target == "mp3") {
+        args.push_back("-vn");
+        if (how == Conversion::Remux) for (const char *a : {"-c:a", "copy"}) args.push_back(a);
+        else for (const char *a : {"-c:a", "libmp3lame", "-q:a", "5"}) args.push_back(a);
+    } else if (how == Conversion::Remux) {
+        for (const char *a : {"-c", "copy"}) args.push_back(a);
+    } else if (how == Conversion::Audio) {
+        for (const char *a : {"-c:v", "copy", "-c:a", "aac", "-b:a", "192k"}) args.push_back(a);
+    }
+    args.push_back(tmp);
+}
+
+// ---------- Adaptive concurrency ----------
+// AIMD over the pool's job limit, fed once per ADAPT_WINDOW_MS with the bytes
+// parsed from progress records:
+//  - throttling errors (HTTP 429/503, timeouts, resets) halve the limit, at
+//    most once per window since jobs already running report them too;
+//  - after an increase, the window following the new jobs' warm-up must show
+//    at least half of the extra rate they should bring (their fair share,
+//    capped by the budget), or the step is undone and the limit holds for
+//    ADAPT_HOLD_WINDOWS;
+//  - otherwise, while every slot is busy, jobs are waiting and the rate is
+//    below the budget, the limit grows up to cfg.jobs: doubling at first
+//    (slow start), by one after the first undone step or throttling.
+// The optional global budget is split evenly into per-child --limit-rate
+// values; a child keeps the share it was started with.
+static const int ADAPT_WINDOW_MS = 2000;
+static const int ADAPT_HOLD_WINDOWS = 10;
+
+class ConcurrencyController {
+public:
+    ConcurrencyController(int maxJobs, bool adaptive, uint64_t budget)
+        : max_(std::max(1, maxJobs)), limit_(adaptive ? std::min(2, max_) : max_), adaptive_(adaptive), budget_(budget) {}
+
+    int limit() const { return limit_; }
+    int max() const { return max_; }
+    bool adaptive() const { return adaptive_; }
+    double rate() const { return rate_; }
+    // False right after a decrease, while throttling reports are ignored.
+    bool responsive() const { return !cooling_; }
+
+    // --limit-rate for a child started now, 0 = none.
+    uint64_t child_rate() const { return budget_ ? std::max<uint64_t>(1024, budget_ / limit_) : 0; }
+
+    // One window's worth of measurements; returns true when the limit changed.
+    bool update(double seconds, uint64_t bytes, int throttled, bool saturated) {
+        rate_ = seconds > 0 ? bytes / seconds : 0;
+        if (!adaptive_) return false;
+        int old = limit_;
+        if (cooling_) {
+            cooling_ = false;
+        } else if (throttled > 0) {
+            limit_ = std::max(1, limit_ / 2);
+            cooling_ = true;
+            probe_ = 0;
+            hold_ = ADAPT_HOLD_WINDOWS;
+            slowStart_ = false;
+        } else if (probe_ > 0) {
+            double expect = before_ * limit_ / prev_;
+            if (budget_) expect = std::min<double>(expect, budget_);
+            if (--probe_ == 0 && rate_ < before_ + 0.5 * (expect - before_)) {
+                limit_ = prev_;
+                hold_ = ADAPT_HOLD_WINDOWS;
+                slowStart_ = false;
+            }
+        } else if (hold_ > 0) {
+            hold_--;
+        } else if (saturated && limit_ < max_ && (budget_ == 0 || rate_ < budget_ * 0.9)) {
+            before_ = rate_;
+            prev_ = limit_;
+            limit_ = std::min(max_, slowStart_ ? limit_ * 2 : limit_ + 1);
+            probe_ = 2;     // one window of warm-up, one to measure
+        }
+        return limit_ != old;
+    }
+
+private:
+    int max_, limit_;
+    bool adaptive_;
+    uint64_t budget_;
+    double rate_ = 0, before_ = 0;   // last window's rate, rate before the pending increase
+    int prev_ = 1;                   // limit before the pending increase
+    int probe_ = 0, hold_ = 0;
+    bool slowStart_ = true, cooling_ = false;
+};
+
+// Hill climb over --concurrent-fragments for lists whose profile says
+// "auto", fed with the download rate of single finished jobs (bytes over
+// download time). The current count is measured over FRAG_SAMPLES downloads,
+// then its double is tried and kept while the median rate gains FRAG_GAIN;
+// if the very first step up loses, halving is tried the same way. After the
+// search it holds for FRAG_HOLD downloads and starts over, since the best
+// count moves with the site and the link. Loop thread only.
+static const int FRAG_START = 4, FRAG_MAX = 32, FRAG_SAMPLES = 3, FRAG_HOLD = 30;
+static const double FRAG_GAIN = 1.15;
+
+class FragmentTuner {
+public:
+    int fragments() const { return phase_ == Phase::Probe ? probe_ : best_; }
+
+    // One finished download fetched with n fragments; true when fragments()
+    // changed. Jobs started before the last change are ignored.
+    bool record(int n, double bps) {
+        if (n != fragments()) return false;
+        samples_.push_back(bps);
+        if (phase_ == Phase::Hold) {
+            if ((int)samples_.size() >= FRAG_HOLD) { samples_.clear(); phase_ = Phase::Measure; }
+            return false;
+        }
+        if ((int)samples_.size() < FRAG_SAMPLES) return false;
+        std::sort(samples_.begin(), samples_.end());
+        double rate = samples_[samples_.size() / 2];
+        samples_.clear();
+        int before = fragments();
+        if (phase_ == Phase::Measure) { rate_ = rate; moved_ = false; up_ = true; step(); }
+        else if (rate > rate_ * FRAG_GAIN) { best_ = probe_; rate_ = rate; moved_ = true; step(); }
+        else if (up_ && !moved_ && best_ > 1) { up_ = false; step(); }
+        else phase_ = Phase::Hold;
+        return fragments() != before;
+    }
+
+    double rate() const { return rate_; }   // median at the kept count
+
+private:
+    enum class Phase { Measure, Probe, Hold };
+
+    // Probes the next count in the current direction, or holds at the end of the range.
+    void step() {
+        int p = up_ ? best_ * 2 : best_ / 2;
+        if (up_ && p > FRAG_MAX && !moved_ && best_ > 1) { up_ = false; p = best_ / 2; }
+        if (p < 1 || p > FRAG_MAX) { phase_ = Phase::Hold; return; }
+        probe_ = p;
+        phase_ = Phase::Probe;
+    }
+
+    Phase phase_ = Phase::Measure;
+    int best_ = FRAG_START, probe_ = FRAG_START;
+    bool up_ = true, moved_ = false;
+    double rate_ = 0;
+    std::vector<double> samples_;
+};
+
+static std::string format_bps(double bps) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.1fMiB/s", bps / 1048576.0);
+    return buf;
+}
+
+// ---------- Progress display ----------
+// Counters the pool's loop thread publishes for the display.
+struct PoolTotals {
+    size_t submitted = 0, done = 0, failed = 0, queued = 0;
+    size_t converting = 0, waiting = 0;   // inside ffmpeg / waiting for it
+    int limit = 0, maxJobs = 0;
+    double rate = 0;
+    bool adaptive = false, paused = false;
+};
+
+static const int RENDER_FRAME_MS = 100;     // redraw interval on a terminal
+static const int PLAIN_STATUS_MS = 5000;    // status line interval when stdout is not a terminal
+
+// Owns stdout while a run is in progress. Its thread samples the published
+// slots and totals, never taking a pool lock, and draws at a fixed rate:
+//   - a dashboard (totals plus one row per active job) with ANSI,
+//   - one status line on a terminal without ANSI,
+//   - the classic progress line of a one-job run,
+//   - a plain "[POOL]" line every PLAIN_STATUS_MS when stdout is not a terminal.
+// Log lines sent through log_line() meanwhile are printed above the display.
+class ProgressRenderer {
+public:
+    ProgressRenderer(const std::vector<JobStatus> &slots, const SeqSlot<PoolTotals> &totals, bool single)
+        : slots_(slots), totals_(totals) {
+        mode_ = !stdout_is_terminal() ? PLAIN : single ? SINGLE : g_ansi_enabled ? DASHBOARD : LINE;
+        if (mode_ != PLAIN) { std::lock_guard<std::mutex> lk(g_out_mutex); g_out_queue = &queue_; }
+        nextPlain_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(PLAIN_STATUS_MS);
+        thread_ = std::thread([this] { run(); });
+    }
+    // Stops drawing and leaves the final totals on screen.
+    ~ProgressRenderer() {
+        { std::lock_guard<std::mutex> lk(m_); stop_ = true; }
+        cv_.notify_all();
+        thread_.join();
+        std::vector<std::pair<bool, std::string>> logs;
+        {
+            std::lock_guard<std::mutex> lk(g_out_mutex);
+            g_out_queue = nullptr;
+            logs.swap(queue_);
+        }
+        draw(logs, true);
+    }
+    ProgressRenderer(const ProgressRenderer&) = delete;
+    ProgressRenderer &operator=(const ProgressRenderer&) = delete;
+
+private:
+    enum Mode { DASHBOARD, LINE, SINGLE, PLAIN };
+
+    void run() {
+        std::unique_lock<std::mutex> lk(m_);
+        while (!cv_.wait_for(lk, std::chrono::milliseconds(mode_ == PLAIN ? PLAIN_STATUS_MS : RENDER_FRAME_MS), [this] { return stop_; })) {
+            lk.unlock();
+            std::vector<std::pair<bool, std::string>> logs;
+            if (mode_ != PLAIN) { std::lock_guard<std::mutex> out(g_out_mutex); logs.swap(queue_); }
+            draw(logs, false);
+            lk.lock();
+        }
+    }
+
+    // "[POOL] 12/40 done, 1 failed, jobs 6/8, 9.5MiB/s | ffmpeg 2 +3 waiting"
+    static std::string status_line(const PoolTotals &t) {
+        std::string line = "[POOL] " + std::to_string(t.done + t.failed) + "/" + std::to_string(t.submitted) + " done";
+        if (t.failed) line += ", " + std::to_string(t.failed) + " failed";
+        if (t.paused) line += ", paused";
+        if (t.adaptive) line += ", jobs " + std::to_string(t.limit) + "/" + std::to_string(t.maxJobs);
+        if (t.rate > 0) line += ", " + format_bps(t.rate);
+        if (t.converting || t.waiting)
+            line += " | ffmpeg " + std::to_string(t.converting) + (t.waiting ? " +" + std::to_string(t.waiting) + " waiting" : "");
+        return line;
+    }
+
+    static std::string fit(std::string line, int width) {
+        if ((int)line.size() >= width) line.resize(std::max(0, width - 1));
+        return line;
+    }
+
+    // Erases the previous frame, prints the queued log lines, then the new frame.
+    void draw(const std::vector<std::pair<bool, std::string>> &logs, bool final) {
+        auto now = std::chrono::steady_clock::now();
+        bool due = final || mode_ != PLAIN || now >= nextPlain_;
+        if (logs.empty() && !due) return;
+        PoolTotals t = totals_.load();
+        int width = terminal_width();
+        std::string out;
+        if (drawn_ > 0) {
+            if (mode_ == DASHBOARD) out += "\r" + (drawn_ > 1 ? "\x1b[" + std::to_string(drawn_ - 1) + "A" : std::string()) + "\x1b[J";
+            else out += line_reset();
+            drawn_ = 0;
+        }
+        std::lock_guard<std::mutex> lk(g_out_mutex);
+        for (auto &l : logs) {
+            if (!l.first) { out += l.second + "\n"; continue; }
+            std::cout << out << std::flush;
+            out.clear();
+            std::cerr << l.second << "\n" << std::flush;
+        }
+        std::vector<std::string> rows;
+        if (final) {
+            if (mode_ != SINGLE && t.submitted > 0) out += status_line(t) + "\n";
+        } else if (mode_ == PLAIN) {
+            if (due) {
+                std::string line = status_line(t);
+                for (auto &s : slots_) if (s.busy) line += " | " + s.tag + " " + percent(s.shown.load());
+                out += line + "\n";
+                nextPlain_ = now + std::chrono::milliseconds(PLAIN_STATUS_MS);
+            }
+        } else if (mode_ == LINE) {
+            std::string line = status_line(t);
+            for (auto &s : slots_) if (s.busy) line += " | " + s.tag + " " + percent(s.shown.load());
+            rows.push_back(line);
+        } else if (mode_ == SINGLE) {
+            static const char spinner[] = "|/-\\";
+            for (auto &s : slots_) {
+                if (!s.busy) continue;
+                ProgressSnapshot p = s.shown.load();
+                char buf[128] = "[RUNNING]";
+                if (p.hasRecord) format_progress(p.rec, buf, sizeof(buf));
+                rows.push_back(std::string(buf) + " " + spinner[frame_ % 4]);
+            }
+            if (rows.empty() && t.converting) rows.push_back("[ffmpeg] converting " + std::string(1, spinner[frame_ % 4]));
+        } else {
+            rows.push_back(status_line(t));
+            for (auto &s : slots_) {
+                if (!s.busy) continue;
+                ProgressSnapshot p = s.shown.load();
+                char buf[128] = "[RUNNING]";
+                if (p.hasRecord) format_progress(p.rec, buf, sizeof(buf));
+                char row[160];
+                std::snprintf(row, sizeof(row), "  %-4s %-44s ", s.tag.c_str(), buf);
+                rows.push_back(row + std::string(p.label));
+            }
+        }
+        for (size_t i = 0; i < rows.size(); ++i) out += (i ? "\n" : "") + fit(rows[i], width);
+        if (mode_ != DASHBOARD && !rows.empty() && !g_ansi_enabled) out += "    ";
+        drawn_ = (int)rows.size();
+        frame_++;
+        std::cout << out << std::flush;
+    }
+
+    static std::string percent(const ProgressSnapshot &p) {
+        return p.permille < 0 ? std::string("...") : std::to_string(p.permille / 10) + "%";
+    }
+
+    const std::vector<JobStatus> &slots_;
+    const SeqSlot<PoolTotals> &totals_;
+    Mode mode_;
+    int drawn_ = 0;       // rows of the current frame on screen
+    unsigned frame_ = 0;
+    std::chrono::steady_clock::time_point nextPlain_;
+    std::vector<std::pair<bool, std::string>> queue_;   // guarded by g_out_mutex
+    std::thread thread_;
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+};
+
+// ---------- Worker pool ----------
+// Where one URL's time went, filled in by the pool; see RunMetrics.
+struct JobMetrics {
+    std::chrono::steady_clock::time_point queuedAt, launchedAt;
+    double queueSec = 0, extractSec = 0, downloadSec = 0, postSec = 0;
+    double totalSec = 0;          // launch to done, transcode included
+    uint64_t bytes = 0;
+    double peakBps = 0;
+    int exitCode = -1;            // yt-dlp
+    int postExitCode = -1;        // ffmpeg, -1 = no transcode
+    int retries = 0;              // earlier failed attempts seen by this pool
+    int fragments = 0;            // --concurrent-fragments used, 0 = yt-dlp's default
+    const char *conversion = nullptr;   // conversion_name() of the plan, null = no target format
+    int stalls = 0, timeouts = 0;       // times the watchdog killed and requeued it
+};
+
+// One queued download: which list it came from and its URL.
+struct PoolEntry {
+    std::string list, url, host;
+    size_t seq = 0;     // 1-based submission number, for "(i/N)" headers
+    bool ok = false;
+    std::string error;  // why it failed: error_class(), "transcode" or "canceled"
+    std::string file;   // downloaded file, when yt-dlp reported it
+    std::string vcodec, acodec;   // its codecs, when yt-dlp reported them
+    std::string id, title;        // likewise, for the catalog
+    double duration = 0;
+    std::chrono::steady_clock::time_point notBefore;   // not started before this
+    enum class Meta { Unknown, Resolving, Resolved };  // prefetch stage
+    Meta meta = Meta::Unknown;
+    MediaInfo info;     // what the prefetch found; info.json empty = start from the URL
+    int passed = 0;     // later entries started before this one (sjf/ljf)
+    JobMetrics m;
+};
+
+// URLs one prefetch run resolves.
+static const size_t PREFETCH_BATCH = 8;
+
+// An entry whose job the watchdog killed goes back to the front of the queue
+// up to WATCHDOG_REQUEUES times, then fails as "stalled" or "timeout" like
+// any transient error. A child that ignores SIGTERM for KILL_GRACE_S gets
+// SIGKILL.
+static const int WATCHDOG_REQUEUES = 3;
+static const int KILL_GRACE_S = 10;
+
+// A file in downloads/ and when it was last written.
+struct OutputFile {
+    std::string name;
+    std::chrono::steady_clock::time_point writtenAt;
+};
+
+static std::vector<OutputFile> list_outputs(std::chrono::steady_clock::time_point now) {
+    std::vector<OutputFile> out;
+    std::error_code ec;
+    auto fnow = fs::file_time_type::clock::now();
+    for (fs::directory_iterator it("downloads", ec), end; !ec && it != end; it.increment(ec)) {
+        if (!it->is_regular_file(ec)) continue;
+        auto mtime = it->last_write_time(ec);
+        if (ec) continue;
+        out.push_back({it->path().filename().string(), now - std::chrono::duration_cast<std::chrono::steady_clock::duration>(fnow - mtime)});
+    }
+    return out;
+}
+
+// What every file of one download starts with: the name a progress record
+// gave ("Title.f137.mp4.part") without .part, extension and format id, so
+// the other streams and the merger's and postprocessors' "Title.temp.mkv"
+// match it too. "" for no name.
+static std::string output_prefix(const std::string &file) {
+    std::string name = fs::path(file).filename().string();
+    if (name.size() > 5 && name.compare(name.size() - 5, 5, ".part") == 0) name.resize(name.size() - 5);
+    size_t dot = name.rfind('.');
+    if (dot == std::string::npos || dot == 0) return name.empty() ? "" : name + ".";
+    name.resize(dot);
+    dot = name.rfind('.');
+    if (dot != std::string::npos && dot + 2 < name.size() && name[dot + 1] == 'f'
+        && std::all_of(name.begin() + dot + 2, name.end(), [](char c) { return std::isalnum((unsigned char)c) || c == '-' || c == '_'; }))
+        name.resize(dot);
+    return name + ".";
+}
+
+// yt-dlp's unfinished files: .part downloads, .ytdl fragment state and
+// "<name>.temp.<ext>" of the merger and postprocessors.
+static bool is_partial_output(const std::string &name) {
+    auto ends = [&](const char *sfx) { size_t n = std::strlen(sfx); return name.size() > n && name.compare(name.size() - n, n, sfx) == 0; };
+    return ends(".part") || ends(".ytdl") || name.find(".temp.") != std::string::npos;
+}
+
+// Runs up to cfg.jobs yt-dlp processes at once (fewer while the adaptive
+// controller holds the limit lower), never more than cfg.perHost against the
+// same host. With cfg.batch > 1 each process gets several URLs of
+// one host. When the output needs re-encoding, a finished download frees its
+// slot at once and moves to a transcode queue served by one ffmpeg per core
+// at background priority, so fetching and encoding overlap; the entry only
+// counts as done (onSuccess) once its transcode succeeded. All children are
+// driven by one ProcessEngine on a single loop thread, which stays alive
+// between submissions so the daemon can keep feeding it; run() covers the
+// one-shot menu case, with a ProgressRenderer drawing the jobs. With jobs=1
+// and inline progress the output is the classic one-download-at-a-time view.
+//
+// With cfg.prefetch, up to jobs/2 extra yt-dlp runs resolve the metadata of
+// the next entries (the first max(16, 4*jobs) that may start) ahead of the
+// workers; see InfoCache. A resolved single-URL job then downloads from the
+// info JSON, entries go in cfg.order within that window, and one whose size
+// does not fit in downloads/ waits for space, or fails as "disk" when nothing
+// is running that could make room.
+//
+// A watchdog on the loop thread kills a job whose output has not moved for
+// cfg.stallTimeout seconds, or that has run for cfg.jobTimeout seconds, and
+// requeues its unfinished entries at once; yt-dlp resumes them from their
+// .part files. The slot is free again as soon as the child is gone. Writes to
+// the job's files in downloads/ count as output, so a merge, postprocessor
+// or external downloader working silently is not taken for a stall; a job
+// that never named its file is matched by any unfinished file no other job
+// claims.
+class DownloadPool {
+public:
+    DownloadPool(const Config &cfg, const std::string &ytdlp, const std::string &ff)
+        : cfg_(cfg), ytdlp_(ytdlp), ff_(ff), target_(transcode_target(cfg, ff)),
+          ctl_(cfg.jobs, cfg.adaptive, cfg.rateLimit) {
+        transcodeJobs_ = std::max(1, (int)std::thread::hardware_concurrency());
+        prefetchJobs_ = std::max(1, cfg.jobs / 2);
+        lookahead_ = (size_t)std::max(16, 4 * cfg.jobs);
+        if (cfg.prefetch) InfoCache::instance().set_ttl(cfg.infoTtl);
+    }
+    ~DownloadPool() { stop(); }
+    DownloadPool(const DownloadPool&) = delete;
+    DownloadPool &operator=(const DownloadPool&) = delete;
+
+    // Called on the loop thread right after each successful download (and
+    // transcode, when there is one).
+    std::function<void(const PoolEntry &e)> onSuccess;
+    // Called on the loop thread after every entry, successful or not.
+    std::function<void(const PoolEntry &e)> onFinish;
+    // Called on the loop thread about every ADAPT_WINDOW_MS while running.
+    std::function<void()> onTick;
+    // Called on the loop thread when an entry starts downloading (Running) and
+    // when it moves on to the transcode stage (Postprocessing).
+    std::function<void(const PoolEntry &e, UrlState s)> onState;
+
+    struct Stats {
+        size_t queued = 0, active = 0, done = 0, failed = 0;
+        size_t converting = 0;          // waiting for or inside ffmpeg
+        bool paused = false;
+        int limit = 0, maxJobs = 0;     // current and highest job count
+        double rate = 0;                // bytes/s over the last window
+    };
+
+    void start(bool inlineProgress) {
+        if (loop_.joinable()) return;
+        int n = std::max(1, cfg_.jobs);
+        inline_ = inlineProgress && n == 1;
+        stopping_ = false;
+        slots_ = std::vector<JobStatus>(n);
+        for (int i=0;i<n;++i) slots_[i].tag = "#" + std::to_string(i+1);
+        loop_ = std::thread([this] { loop(); });
+    }
+
+    // Lets the running jobs finish, drops the queue and joins the loop.
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stopping_ = true;
+            queue_.clear();
+        }
+        engine_.wake();
+        if (loop_.joinable()) loop_.join();
+    }
+
+    // Queues URLs of a list; they are not started before notBefore (retries
+    // waiting out their backoff).
+    void submit(const std::string &list, const std::vector<std::string> &urls,
+                std::chrono::steady_clock::time_point notBefore = {}) {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            auto now = std::chrono::steady_clock::now();
+            for (auto &u : urls) {
+                PoolEntry e;
+                e.list = list; e.url = u; e.host = url_host(u); e.seq = ++submitted_;
+                e.notBefore = notBefore;
+                e.m.queuedAt = std::max(now, notBefore);
+                auto f = failures_.find(list + "\n" + u);
+                if (f != failures_.end()) e.m.retries = f->second;
+                queue_.push_back(std::move(e));
+            }
+        }
+        engine_.wake();
+    }
+
+    // Drops the failed-attempt count of an entry that will not be submitted
+    // again (done, quarantined or canceled), so a long-lived pool does not
+    // keep one for every URL that ever failed.
+    void forget(const PoolEntry &e) {
+        std::lock_guard<std::mutex> lk(m_);
+        failures_.erase(e.list + "\n" + e.url);
+    }
+
+    // Drops and returns the queued entries of one list ("" = all lists),
+    // including downloads waiting for a transcode, and kills its running
+    // jobs; those then finish as failed.
+    std::vector<PoolEntry> cancel(const std::string &list) {
+        std::vector<PoolEntry> dropped;
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            for (auto *q : {&queue_, &post_}) {
+                for (auto it = q->begin(); it != q->end();) {
+                    if (list.empty() || it->list == list) { dropped.push_back(std::move(*it)); it = q->erase(it); }
+                    else ++it;
+                }
+            }
+            for (auto &j : running_) if (list.empty() || j->entries[0].list == list) j->killRequested = true;
+            for (auto &t : converting_) if (list.empty() || t->entry.list == list) t->killRequested = true;
+        }
+        engine_.wake();
+        return dropped;
+    }
+
+    void set_paused(bool p) {
+        { std::lock_guard<std::mutex> lk(m_); paused_ = p; }
+        engine_.wake();
+    }
+
+    bool is_queued(const std::string &list, const std::string &url) {
+        std::lock_guard<std::mutex> lk(m_);
+        for (auto &e : queue_) if (e.list == list && e.url == url) return true;
+        for (auto &e : post_) if (e.list == list && e.url == url) return true;
+        for (auto &j : running_) for (auto &e : j->entries) if (e.list == list && e.url == url) return true;
+        for (auto &t : converting_) if (t->entry.list == list && t->entry.url == url) return true;
+        return false;
+    }
+
+    Stats stats() {
+        std::lock_guard<std::mutex> lk(m_);
+        Stats st;
+        st.queued = queue_.size(); st.done = done_; st.failed = failed_; st.paused = paused_;
+        st.converting = post_.size() + converting_.size();
+        st.limit = ctl_.limit(); st.maxJobs = ctl_.max(); st.rate = ctl_.rate();
+        for (auto &j : running_) st.active += j->entries.size();
+        return st;
+    }
+
+    // One "<tag> <progress> <url>" line per running job.
+    std::vector<std::string> active_jobs() {
+        std::lock_guard<std::mutex> lk(m_);
+        std::vector<std::string> out;
+        for (auto &j : running_) {
+            int pm = j->slot->shown.load().permille;
+            std::string pct = pm < 0 ? "..." : std::to_string(pm / 10) + "." + std::to_string(pm % 10) + "%";
+            std::string label = j->entries[0].url;
+            if (j->entries.size() > 1) label += " (+" + std::to_string(j->entries.size() - 1) + " more)";
+            out.push_back(j->slot->tag + " " + pct + " " + label);
+        }
+        for (auto &t : converting_) out.push_back("ffmpeg " + target_ + " " + t->entry.url);
+        return out;
+    }
+
+    // Blocks until nothing is queued or running.
+    void wait_idle() {
+        std::unique_lock<std::mutex> lk(m_);
+        idle_.wait(lk, [this] { return !busy(); });
+    }
+
+    // One-shot: downloads every URL of a list and returns when all are done.
+    void run(const std::string &list, const std::vector<std::string> &urls) {
+        start(true);
+        {
+            ProgressRenderer view(slots_, totals_, inline_);
+            submit(list, urls);
+            wait_idle();
+        }
+        stop();
+    }
+
+private:
+    struct Job {
+        std::vector<PoolEntry> entries;
+        JobStatus *slot = nullptr;
+        std::unique_ptr<JobOutput> out;
+        DoneItems done;                   // items reported by DONE_TAG markers
+        std::string batchFile;
+        int child = -1;
+        bool killRequested = false, killSent = false, hardKill = false;
+        const char *watchdog = nullptr;           // "stalled" / "timeout" when the watchdog killed it
+        std::chrono::steady_clock::time_point killSentAt;
+        std::chrono::steady_clock::time_point outputAt;   // last write the watchdog saw to its files in downloads/
+        uint64_t reserve = 0, bytesAtStart = 0;   // disk admission: expected size, slot bytes at launch
+        int fragments = 0;                        // --concurrent-fragments, 0 = not set
+    };
+
+    // One metadata prefetch run.
+    struct Prefetch {
+        std::vector<std::string> urls;
+        std::string batchFile, tmpDir;
+        std::map<std::string, std::vector<std::string>> meta;   // url -> META_TAG lines after the url
+        int child = -1;
+        bool killSent = false;
+    };
+
+    // One ffmpeg run of the transcode stage.
+    struct Transcode {
+        PoolEntry entry;
+        std::string out, tmp;     // final file, and where ffmpeg writes it first
+        std::string error;        // last ffmpeg error line
+        int child = -1;
+        bool killRequested = false, killSent = false;
+    };
+
+    // Anything queued, downloading or converting; caller holds m_.
+    bool busy() const { return !queue_.empty() || !running_.empty() || !post_.empty() || !converting_.empty() || rejecting_ > 0; }
+
+    // What a reported download still needs from ffmpeg.
+    Conversion conversion(const PoolEntry &e) const { return plan_conversion(target_, e.file, e.vcodec, e.acodec); }
+    // Next eligible queued entry whose host is below the cap, plus up to
+    // cfg.batch-1 more eligible entries of the same list and host; caller
+    // holds m_. Entries still backing off are skipped; the loop wakes at
+    // least every 250 ms, which is fine-grained enough for them.
+    bool take_job(std::vector<PoolEntry> &job) {
+        job.clear();
+        if (paused_ || stopping_) return false;
+        auto now = std::chrono::steady_clock::now();
+        for (auto it = cfg_.prefetch ? pick_prefetched(now) : queue_.begin(); it != queue_.end(); ++it) {
+            if (it->notBefore > now || hostActive_[it->host] >= cfg_.perHost) continue;
+            job.push_back(std::move(*it));
+            it = queue_.erase(it);
+            const PoolEntry &first = job[0];
+            while (it != queue_.end() && (int)job.size() < cfg_.batch) {
+                if (it->host == first.host && it->list == first.list && it->notBefore <= now) { job.push_back(std::move(*it)); it = queue_.erase(it); }
+                else ++it;
+            }
+            hostActive_[first.host]++;
+            return true;
+        }
+        return false;
+    }
+
+    // With prefetch: the entry to start next, or queue_.end(). Among the
+    // first lookahead_ entries that may start, resolved ones go first in
+    // cfg.order, those of unknown size after the others; one passed over
+    // lookahead_ times goes next regardless. With none resolved, the first
+    // entry not being resolved right now starts from its URL. Entries that
+    // cannot fit on disk move to rejected_. Caller holds m_.
+    std::deque<PoolEntry>::iterator pick_prefetched(std::chrono::steady_clock::time_point now) {
+        auto best = queue_.end(), fallback = queue_.end();
+        bool sized = cfg_.order != "fifo";
+        uint64_t avail = free_space(now), used = reserved();
+        bool idle = running_.empty() && converting_.empty() && post_.empty();
+        size_t seen = 0;
+        for (auto it = queue_.begin(); it != queue_.end();) {
+            if (seen >= lookahead_ && (fallback != queue_.end() || best != queue_.end())) break;
+            if (it->notBefore > now) { ++it; continue; }
+            bool inWindow = seen++ < lookahead_;
+            if (hostActive_[it->host] >= cfg_.perHost || it->meta == PoolEntry::Meta::Resolving) { ++it; continue; }
+            if (it->meta == PoolEntry::Meta::Unknown && InfoCache::instance().lookup(it->url, it->info)) it->meta = PoolEntry::Meta::Resolved;
+            if (it->meta == PoolEntry::Meta::Unknown) { if (fallback == queue_.end()) fallback = it; ++it; continue; }
+            if (!inWindow) { ++it; continue; }
+            uint64_t need = it->info.bytes * (target_.empty() ? 1 : 2);
+            if (need && (avail < used || need + cfg_.minFree > avail - used)) {
+                if (idle) {
+                    char why[128];
+                    std::snprintf(why, sizeof(why), "needs %.1fMiB + min_free %.1fMiB, %.1fMiB free", need / 1048576.0,
+                                  cfg_.minFree / 1048576.0, avail / 1048576.0);
+                    rejected_.push_back({std::move(*it), why});
+                    queue_.erase(it);
+                    // erase invalidated every iterator, end() included; start over
+                    return pick_prefetched(now);
+                }
+                ++it;
+                continue;
+            }
+            if (it->passed >= (int)lookahead_) { best = it; break; }
+            if (best == queue_.end() || (sized && sooner(*it, *best))) best = it;
+            ++it;
+        }
+        if (best == queue_.end()) return fallback;
+        for (auto it = queue_.begin(); it != best; ++it) if (it->meta == PoolEntry::Meta::Resolved) it->passed++;
+        return best;
+    }
+
+    // Free bytes in downloads/, sampled at most once per ADAPT_WINDOW_MS so
+    // the pick does not cost a statfs() per job; reserved() covers what the
+    // running jobs write in between. Caller holds m_.
+    uint64_t free_space(std::chrono::steady_clock::time_point now) {
+        if (spaceAt_ != std::chrono::steady_clock::time_point() && now - spaceAt_ < std::chrono::milliseconds(ADAPT_WINDOW_MS))
+            return space_;
+        std::error_code ec;
+        fs::space_info sp = fs::space(fs::exists("downloads", ec) ? "downloads" : ".", ec);
+        space_ = ec ? UINT64_MAX : sp.available;
+        spaceAt_ = now;
+        return space_;
+    }
+
+    // cfg.order between two resolved entries; unknown sizes go last.
+    bool sooner(const PoolEntry &a, const PoolEntry &b) const {
+        if ((a.info.bytes > 0) != (b.info.bytes > 0)) return a.info.bytes > 0;
+        return cfg_.order == "sjf" ? a.info.bytes < b.info.bytes : a.info.bytes > b.info.bytes;
+    }
+
+    // Bytes the started downloads and transcodes are still expected to
+    // write; caller holds m_.
+    uint64_t reserved() const {
+        uint64_t r = 0;
+        for (auto &j : running_) { uint64_t got = j->slot->bytes - j->bytesAtStart; if (j->reserve > got) r += j->reserve - got; }
+        for (auto &t : converting_) r += t->entry.info.bytes;
+        for (auto &e : post_) r += e.info.bytes;
+        return r;
+    }
+
+    // Marks up to PREFETCH_BATCH unknown entries among the first lookahead_
+    // that may start as resolving and returns their URLs; entries the cache
+    // already knows are resolved on the spot. Caller holds m_.
+    std::vector<std::string> next_prefetch() {
+        std::vector<std::string> urls;
+        auto now = std::chrono::steady_clock::now();
+        size_t seen = 0;
+        for (auto &e : queue_) {
+            if (seen >= lookahead_ || urls.size() >= PREFETCH_BATCH) break;
+            if (e.notBefore > now) continue;
+            seen++;
+            if (e.meta != PoolEntry::Meta::Unknown) continue;
+            if (InfoCache::instance().lookup(e.url, e.info)) { e.meta = PoolEntry::Meta::Resolved; continue; }
+            e.meta = PoolEntry::Meta::Resolving;
+            if (std::find(urls.begin(), urls.end(), e.url) == urls.end()) urls.push_back(e.url);
+        }
+        return urls;
+    }
+
+    // Spawns one prefetch run; caller holds m_. Returns it when the spawn
+    // failed, like launch().
+    Prefetch *launch_prefetch(std::vector<std::string> urls) {
+        std::unique_ptr<Prefetch> p(new Prefetch);
+        p->urls = std::move(urls);
+        std::string id = std::to_string(++prefetched_);
+#ifndef _WIN32
+        id = std::to_string((long)getpid()) + "-" + id;
+#endif
+        ensure_dir("internals/tmp");
+        p->batchFile = "internals/tmp/prefetch-" + id + ".txt";
+        p->tmpDir = InfoCache::dir() + "/tmp-" + id;
+        ensure_dir(p->tmpDir);
+        std::ofstream bf(p->batchFile);
+        for (auto &u : p->urls) bf << u << "\n";
+        bf.close();
+        std::vector<std::string> args;
+        build_yt_dlp_prefetch_cmd(cfg_, ytdlp_, ff_, p->batchFile, p->tmpDir, args);
+        Prefetch *pp = p.get();
+        p->child = engine_.spawn(args,
+            [pp](const std::string &line, bool) {
+                if (!starts_with(line, META_TAG)) return;
+                std::string rest = trim(line.substr(sizeof(META_TAG) - 1));
+                size_t tab = rest.find('\t');
+                if (tab != std::string::npos) pp->meta[rest.substr(0, tab)].push_back(rest.substr(tab + 1));
+            },
+            [this, pp](const ChildResult &r) { finish_prefetch(pp, r); });
+        if (p->child >= 0) engine_.lower_priority(p->child);
+        prefetching_.push_back(std::move(p));
+        return pp->child < 0 ? pp : nullptr;
+    }
+
+    // Exit callback of a prefetch run (loop thread, m_ not held): caches what
+    // it resolved and marks its entries resolved. A URL it did not resolve,
+    // or that gave several items (a playlist), downloads from the URL.
+    void finish_prefetch(Prefetch *p, const ChildResult &) {
+        std::remove(p->batchFile.c_str());
+        std::map<std::string, MediaInfo> found;
+        for (auto &u : p->urls) {
+            auto it = p->meta.find(u);
+            if (it == p->meta.end() || it->second.size() != 1) continue;
+            // "<extractor>-<id>\t<bytes>\t<seconds>"
+            const std::string &f = it->second[0];
+            size_t a = f.find('\t'), b = a == std::string::npos ? a : f.find('\t', a + 1);
+            if (b == std::string::npos) continue;
+            MediaInfo mi;
+            mi.bytes = (uint64_t)std::max(0.0, std::atof(f.c_str() + a + 1));
+            mi.duration = std::atof(f.c_str() + b + 1);
+            if (InfoCache::instance().store(u, p->tmpDir + "/" + f.substr(0, a) + ".info.json", mi)) found[u] = mi;
+        }
+        std::error_code ec;
+        fs::remove_all(p->tmpDir, ec);
+        std::lock_guard<std::mutex> lk(m_);
+        for (auto &e : queue_) {
+            if (e.meta != PoolEntry::Meta::Resolving || std::find(p->urls.begin(), p->urls.end(), e.url) == p->urls.end()) continue;
+            e.meta = PoolEntry::Meta::Resolved;
+            auto it = found.find(e.url);
+            if (it != found.end()) e.info = it->second;
+        }
+        prefetching_.erase(std::find_if(prefetching_.begin(), prefetching_.end(),
+                           [&](const std::unique_ptr<Prefetch> &q) { return q.get() == p; }));
+    }
+
+    // An entry that does not fit on disk with nothing left to make room
+    // (loop thread, m_ not held): it fails as "disk", a transient class.
+    void finish_rejected(PoolEntry &e, const std::string &why) {
+        e.ok = false;
+        e.error = "disk";
+        e.m.launchedAt = std::chrono::steady_clock::now();
+        e.m.queueSec = std::chrono::duration<double>(e.m.launchedAt - e.m.queuedAt).count();
+        count_failure(e);
+        log_line("[FAIL] not enough disk space in downloads/ (" + why + "): " + e.url, true);
+        if (onFinish) onFinish(e);
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            failed_++;
+            rejecting_--;
+            publish_totals();
+        }
+        idle_.notify_all();
+    }
+
+    void loop() {
+        std::unique_lock<std::mutex> lk(m_);
+        window_ = std::chrono::steady_clock::now();
+        while (true) {
+            std::vector<std::string> watched = watch();
+            for (auto &j : running_) if (j->killRequested && !j->killSent) {
+                engine_.kill(j->child);
+                j->killSent = true;
+                j->killSentAt = std::chrono::steady_clock::now();
+            }
+            for (auto &t : converting_) if (t->killRequested && !t->killSent) { engine_.kill(t->child); t->killSent = true; }
+            if (stopping_) for (auto &p : prefetching_) if (!p->killSent && p->child >= 0) { engine_.kill(p->child); p->killSent = true; }
+            bool tick = false;
+            std::string adapted = sample_window(tick);
+            std::vector<PoolEntry> entries;
+            std::vector<Job*> failedSpawns;
+            std::vector<Transcode*> failedTranscodes;
+            while ((int)running_.size() < ctl_.limit() && take_job(entries))
+                if (Job *j = launch(std::move(entries))) failedSpawns.push_back(j);
+            std::vector<std::pair<PoolEntry, std::string>> rejected;
+            rejected.swap(rejected_);
+            rejecting_ += rejected.size();
+            std::vector<Prefetch*> failedPrefetches;
+            while (cfg_.prefetch && !paused_ && !stopping_ && (int)prefetching_.size() < prefetchJobs_) {
+                std::vector<std::string> urls = next_prefetch();
+                if (urls.empty()) break;
+                if (Prefetch *p = launch_prefetch(std::move(urls))) failedPrefetches.push_back(p);
+            }
+            std::vector<Job*> started;
+            started.swap(started_);
+            while ((int)converting_.size() < transcodeJobs_ && !post_.empty()) {
+                PoolEntry e = std::move(post_.front());
+                post_.pop_front();
+                if (Transcode *t = launch_transcode(std::move(e))) failedTranscodes.push_back(t);
+            }
+            publish_totals();
+            // downloads waiting for ffmpeg are finished even when stopping
+            if (stopping_ && running_.empty() && post_.empty() && converting_.empty() && prefetching_.empty()) break;
+            lk.unlock();
+            if (!adapted.empty()) log_line(adapted);
+            for (auto &w : watched) log_line(w, true);
+            if (tick && onTick) onTick();
+            // running_ only shrinks on this thread, so the jobs are still there
+            for (Job *j : started) if (onState) for (auto &e : j->entries) onState(e, UrlState::Running);
+            ChildResult spawnFailed;
+            spawnFailed.exitCode = 127;
+            for (Job *j : failedSpawns) {
+                log_line("[ERR] failed to start " + ytdlp_, true);
+                finish(j, spawnFailed);
+            }
+            for (Transcode *t : failedTranscodes) {
+                log_line("[ERR] failed to start " + ff_, true);
+                finish_transcode(t, spawnFailed);
+            }
+            for (Prefetch *p : failedPrefetches) {
+                log_line("[ERR] failed to start " + ytdlp_ + " for metadata", true);
+                finish_prefetch(p, spawnFailed);
+            }
+            for (auto &r : rejected) finish_rejected(r.first, r.second);
+            if (failedSpawns.empty() && failedTranscodes.empty() && failedPrefetches.empty() && rejected.empty())
+                engine_.poll_once(250);
+            lk.lock();
+        }
+    }
+
+    // Flags running jobs that stalled or ran out of time for killing, and
+    // escalates to SIGKILL for killed ones still alive after KILL_GRACE_S;
+    // caller holds m_. Returns a log line per job flagged.
+    std::vector<std::string> watch() {
+        std::vector<std::string> out;
+        auto now = std::chrono::steady_clock::now();
+        std::vector<OutputFile> files;
+        std::vector<std::string> prefixes;   // of every running job, "" when unknown
+        bool listed = false;
+        for (auto &j : running_) {
+            if (j->child < 0) continue;
+            if (j->killSent) {
+                if (!j->hardKill && now - j->killSentAt >= std::chrono::seconds(KILL_GRACE_S)) {
+                    engine_.kill(j->child, true);
+                    j->hardKill = true;
+                }
+                continue;
+            }
+            if (j->killRequested) continue;
+            double idle = std::chrono::duration<double>(now - std::max(j->out->last_activity(), j->outputAt)).count();
+            if (cfg_.stallTimeout > 0 && idle >= cfg_.stallTimeout) {
+                // only listed when a job looks stalled: once per stallTimeout at most
+                if (!listed) {
+                    files = list_outputs(now);
+                    for (auto &r : running_) prefixes.push_back(output_prefix(r->out->file()));
+                    listed = true;
+                }
+                std::string mine = output_prefix(j->out->file());
+                for (auto &f : files) {
+                    bool match = !mine.empty() ? f.name.compare(0, mine.size(), mine) == 0
+                        : is_partial_output(f.name) && std::none_of(prefixes.begin(), prefixes.end(), [&](const std::string &p) {
+                              return !p.empty() && f.name.compare(0, p.size(), p) == 0; });
+                    if (match) j->outputAt = std::max(j->outputAt, f.writtenAt);
+                }
+                idle = std::chrono::duration<double>(now - std::max(j->out->last_activity(), j->outputAt)).count();
+            }
+            double ran = std::chrono::duration<double>(now - j->entries[0].m.launchedAt).count();
+            char why[96];
+            if (cfg_.stallTimeout > 0 && idle >= cfg_.stallTimeout) {
+                j->watchdog = "stalled";
+                std::snprintf(why, sizeof(why), "no progress for %.0fs", idle);
+            } else if (cfg_.jobTimeout > 0 && ran >= cfg_.jobTimeout) {
+                j->watchdog = "timeout";
+                std::snprintf(why, sizeof(why), "running for %.0fs", ran);
+            } else continue;
+            j->killRequested = true;
+            std::string label = j->entries[0].url;
+            if (j->entries.size() > 1) label += " (+" + std::to_string(j->entries.size() - 1) + " more)";
+            out.push_back((inline_ ? "" : "[" + j->slot->tag + "] ") + "[WATCHDOG] " + label + ": " + why + ", killing it");
+        }
+        return out;
+    }
+
+    // Feeds the controller once per window, or at once when a job reports
+    // throttling; caller holds m_. Returns a log line when the limit changed.
+    std::string sample_window(bool &tick) {
+        auto now = std::chrono::steady_clock::now();
+        double secs = std::chrono::duration<double>(now - window_).count();
+        uint64_t bytes = 0;
+        int throttled = 0;
+        for (auto &s : slots_) { bytes += s.bytes; throttled += s.throttled; }
+        if (secs * 1000 < ADAPT_WINDOW_MS && (throttled == windowThrottled_ || !ctl_.responsive())) return "";
+        tick = true;
+        window_ = now;
+        std::string msg;
+        int old = ctl_.limit();
+        // idle stretches say nothing about the link
+        if (!running_.empty()) {
+            bool saturated = !paused_ && !queue_.empty() && (int)running_.size() >= ctl_.limit();
+            if (ctl_.update(secs, bytes - windowBytes_, throttled - windowThrottled_, saturated))
+                msg = "[ADAPT] jobs " + std::to_string(old) + " -> " + std::to_string(ctl_.limit()) + " at " + format_bps(ctl_.rate())
+                    + (throttled > windowThrottled_ ? " (throttled)" : "");
+        }
+        windowBytes_ = bytes;
+        windowThrottled_ = throttled;
+        return msg;
+    }
+
+    // Spawns yt-dlp for one job; caller holds m_. Returns the job when the
+    // spawn failed, so the caller can finish() it without the lock.
+    Job *launch(std::vector<PoolEntry> entries) {
+        std::unique_ptr<Job> job(new Job);
+        job->entries = std::move(entries);
+        auto now = std::chrono::steady_clock::now();
+        for (auto &e : job->entries) {
+            e.m.launchedAt = now;
+            e.m.queueSec = std::chrono::duration<double>(now - e.m.queuedAt).count();
+        }
+        for (auto &s : slots_) if (!s.busy) { job->slot = &s; break; }
+        job->slot->busy = true;
+        job->slot->draft = ProgressSnapshot();
+        std::string label = job->entries[0].url;
+        if (job->entries.size() > 1) label += " +" + std::to_string(job->entries.size() - 1) + " more";
+        std::snprintf(job->slot->draft.label, sizeof(job->slot->draft.label), "%s", label.c_str());
+        job->slot->publish();
+        for (auto &e : job->entries) job->reserve += e.info.bytes;
+        job->bytesAtStart = job->slot->bytes;
+        std::vector<std::string> args;
+        std::error_code ec;
+        const std::string &info = job->entries[0].info.json;
+        if (job->entries.size() == 1 && !info.empty() && fs::exists(info, ec)) {
+            build_yt_dlp_info_cmd(cfg_, ytdlp_, ff_, info, args);
+        } else if (job->entries.size() == 1) {
+            build_yt_dlp_cmd(cfg_, ytdlp_, ff_, job->entries[0].url, args);
+        } else {
+            ensure_dir("internals/tmp");
+            // seq restarts in every process; other instances share internals/tmp
+            std::string id = std::to_string(job->entries[0].seq);
+#ifndef _WIN32
+            id = std::to_string((long)getpid()) + "-" + id;
+#else
+            id = std::to_string((long)GetCurrentProcessId()) + "-" + id;
+#endif
+            job->batchFile = "internals/tmp/batch-" + id + ".txt";
+            std::ofstream bf(job->batchFile);
+            for (auto &e : job->entries) bf << e.url << "\n";
+            bf.close();
+            build_yt_dlp_batch_cmd(cfg_, ytdlp_, ff_, job->batchFile, args);
+        }
+        const DownloadProfile &prof = profile(job->entries[0].list);
+        job->fragments = prof.autoFragments ? tuners_[job->entries[0].list].fragments() : prof.fragments;
+        for (auto &e : job->entries) e.m.fragments = job->fragments;
+        add_profile_args(prof, job->fragments, args);
+        if (uint64_t r = ctl_.child_rate()) args.insert(args.begin() + 1, {"--limit-rate", std::to_string(r)});
+        if (inline_) {
+            log_line("\n--- (" + std::to_string(job->entries[0].seq) + "/" + std::to_string(submitted_) + ") " + label + " ---");
+            log_line("[CMD] " + display_cmd(args));
+        }
+        job->out.reset(new JobOutput(job->slot, inline_, &job->done));
+        Job *jp = job.get();
+        job->child = engine_.spawn(args,
+            [jp](const std::string &line, bool) { jp->out->line(line); },
+            [this, jp](const ChildResult &r) { finish(jp, r); });
+        running_.push_back(std::move(job));
+        if (jp->child >= 0) started_.push_back(jp);
+        return jp->child < 0 ? jp : nullptr;
+    }
+
+    // Exit callback (loop thread, m_ not held): attributes success per entry.
+    void finish(Job *job, const ChildResult &r) {
+        job->out->finish();
+        if (!job->batchFile.empty()) std::remove(job->batchFile.c_str());
+        // a batch succeeds per item: only URLs yt-dlp reported as finished count
+        std::unordered_map<std::string, std::vector<const DoneItem*>> reported;
+        for (auto &d : job->done) reported[d.url].push_back(&d);
+        for (auto &e : job->entries) {
+            auto it = reported.find(e.url);
+            bool seen = it != reported.end() && !it->second.empty();
+            const ItemTiming *t = &job->out->current();
+            if (seen) {
+                const DoneItem *d = it->second.back();
+                t = &d->timing; e.file = d->file; e.vcodec = d->vcodec; e.acodec = d->acodec;
+                e.id = d->id; e.title = d->title; e.duration = d->duration;
+                it->second.pop_back();
+            }
+            e.ok = job->entries.size() == 1 ? r.exitCode == 0 : seen;
+            if (!e.ok) e.error = job->watchdog ? job->watchdog : job->killSent ? "canceled"
+                               : failure_class(e, job->out->errors(), job->entries.size() == 1);
+            // the info JSON is used up, or may be why it failed; it survives
+            // failures that had nothing to do with it
+            if (!e.info.json.empty() && (e.ok || (e.error != "throttled" && e.error != "network" && e.error != "canceled"
+                                                  && e.error != "stalled" && e.error != "timeout")))
+                InfoCache::instance().forget(e.url);
+            // unreported batch items are charged the whole job
+            if (!seen && job->entries.size() > 1) t = nullptr;
+            record_timing(e, t, r);
+            tune_fragments(e, job->fragments);
+        }
+        char usage[96];
+        std::snprintf(usage, sizeof(usage), " [cpu %.1fs, rss %ldMB, %.1fs]", r.userSec + r.sysSec, r.maxRssKb / 1024, r.wallSec);
+        size_t nok = 0, nfail = 0;
+        JobStatus *st = inline_ ? nullptr : job->slot;
+        std::string pre = st ? "[" + st->tag + "] " : "";
+        bool named = st || job->entries.size() > 1;
+        std::vector<PoolEntry> toConvert, requeue;
+        for (auto &e : job->entries) {
+            if (!e.ok && job->watchdog && e.m.stalls + e.m.timeouts < WATCHDOG_REQUEUES) {
+                (e.error == "stalled" ? e.m.stalls : e.m.timeouts)++;
+                log_line(pre + "[WATCHDOG] " + e.url + ": " + e.error + ", requeued (" + std::to_string(e.m.stalls + e.m.timeouts)
+                         + "/" + std::to_string(WATCHDOG_REQUEUES) + ")" + usage, true);
+                e.error.clear();
+                e.m.queuedAt = std::chrono::steady_clock::now();
+                e.notBefore = {};
+                if (onState) onState(e, UrlState::Queued);
+                requeue.push_back(e);
+                continue;
+            }
+            if (!e.ok && job->watchdog) (e.error == "stalled" ? e.m.stalls : e.m.timeouts)++;
+            Conversion how = conversion(e);
+            if (e.ok && !target_.empty()) e.m.conversion = conversion_name(how);
+            if (e.ok && how != Conversion::None) {
+                log_line(pre + "[DL] " + (named ? e.url : "Download finished") + usage + ", " + target_ + ": "
+                         + conversion_name(how) + " (" + (e.vcodec.empty() ? "?" : e.vcodec) + "/" + (e.acodec.empty() ? "?" : e.acodec) + ")");
+                if (onState) onState(e, UrlState::Postprocessing);
+                toConvert.push_back(e);
+                continue;
+            }
+            if (!e.ok) {
+                count_failure(e);
+                nfail++;
+                log_line(pre + "[FAIL] yt-dlp exit " + std::to_string(r.exitCode) + " (" + e.error + ")"
+                         + (named ? ": " + e.url : "") + usage, true);
+            }
+            if (e.ok && onSuccess) onSuccess(e);
+            if (onFinish) onFinish(e);
+            if (e.ok) {
+                nok++;
+                log_line(pre + "[OK] " + (named ? e.url : "Download succeeded, removing from list") + usage
+                         + (e.m.conversion ? ", already " + target_ : ""));
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            job->slot->busy = false;
+            hostActive_[job->entries[0].host]--;
+            done_ += nok;
+            failed_ += nfail;
+            for (auto &e : toConvert) post_.push_back(std::move(e));
+            for (auto it = requeue.rbegin(); it != requeue.rend(); ++it) queue_.push_front(std::move(*it));
+            running_.erase(std::find_if(running_.begin(), running_.end(),
+                           [&](const std::unique_ptr<Job> &j) { return j.get() == job; }));
+            publish_totals();
+        }
+        idle_.notify_all();
+    }
+
+    // Starts ffmpeg for one downloaded entry at background priority; caller
+    // holds m_. Returns the transcode when the spawn failed, like launch().
+    Transcode *launch_transcode(PoolEntry e) {
+        std::unique_ptr<Transcode> t(new Transcode);
+        fs::path in(e.file);
+        t->out = fs::path(in).replace_extension(target_).string();
+        t->tmp = fs::path(in).replace_extension("temp." + target_).string();
+        t->entry = std::move(e);
+        std::vector<std::string> args;
+        build_transcode_cmd(ff_, target_, conversion(t->entry), t->entry.file, t->tmp, args);
+        Transcode *tp = t.get();
+        t->child = engine_.spawn(args,
+            [tp](const std::string &line, bool) { if (!trim(line).empty()) tp->error = trim(line); },
+            [this, tp](const ChildResult &r) { finish_transcode(tp, r); });
+        if (t->child >= 0) engine_.lower_priority(t->child);
+        converting_.push_back(std::move(t));
+        return tp->child < 0 ? tp : nullptr;
+    }
+
+    // Exit callback of a transcode (loop thread, m_ not held): the converted
+    // file replaces the download, and only now the entry counts as done.
+    void finish_transcode(Transcode *t, const ChildResult &r) {
+        PoolEntry &e = t->entry;
+        std::error_code ec;
+        e.ok = r.exitCode == 0 && replace_file(t->tmp, t->out);
+        if (e.ok) { if (t->out != e.file) fs::remove(e.file, ec); e.file = t->out; }
+        else { fs::remove(t->tmp, ec); e.error = t->killSent ? "canceled" : "transcode"; }
+        e.m.postSec = r.wallSec;
+        e.m.postExitCode = r.exitCode;
+        e.m.totalSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - e.m.launchedAt).count();
+        char usage[96];
+        std::snprintf(usage, sizeof(usage), " [cpu %.1fs, rss %ldMB, %.1fs]", r.userSec + r.sysSec, r.maxRssKb / 1024, r.wallSec);
+        if (!e.ok) {
+            count_failure(e);
+            log_line("[ffmpeg] [FAIL] exit " + std::to_string(r.exitCode) + (t->killSent ? " (canceled)" : "")
+                     + ": " + e.url + (t->error.empty() ? "" : " (" + t->error + ")") + usage, true);
+        }
+        if (e.ok && onSuccess) onSuccess(e);
+        if (onFinish) onFinish(e);
+        if (e.ok) log_line("[ffmpeg] [OK] " + e.url + " -> " + t->out + usage);
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (e.ok) done_++; else failed_++;
+            converting_.erase(std::find_if(converting_.begin(), converting_.end(),
+                              [&](const std::unique_ptr<Transcode> &c) { return c.get() == t; }));
+            publish_totals();
+        }
+        idle_.notify_all();
+    }
+
+    // Feeds a finished download to its list's FragmentTuner, when the profile
+    // says "auto"; loop thread. Short downloads say little about the rate.
+    void tune_fragments(const PoolEntry &e, int fragments) {
+        if (!e.ok || e.m.downloadSec < 1 || e.m.bytes < (4u << 20)) return;
+        auto it = tuners_.find(e.list);
+        if (it == tuners_.end()) return;
+        if (it->second.record(fragments, e.m.bytes / e.m.downloadSec))
+            log_line("[TUNE] '" + e.list + "': " + std::to_string(it->second.fragments()) + " fragments per download (best so far "
+                     + format_bps(it->second.rate()) + " per job)");
+    }
+
+    // A list's download profile, re-read when its file changes; loop thread.
+    const DownloadProfile &profile(const std::string &list) {
+        std::error_code ec;
+        fs::file_time_type mtime = fs::last_write_time(profile_path(list), ec);
+        if (ec) mtime = fs::file_time_type();
+        CachedProfile &c = profiles_[list];
+        if (!c.loaded || c.mtime != mtime) {
+            c.loaded = true;
+            c.mtime = mtime;
+            c.profile = load_profile(list);
+            if (c.profile.autoFragments) tuners_[list];
+        }
+        return c.profile;
+    }
+
+    // Fills the download part of e.m from its item timing (null = the whole job).
+    void record_timing(PoolEntry &e, const ItemTiming *t, const ChildResult &r) {
+        auto end = std::chrono::steady_clock::now();
+        auto secs = [](std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b) {
+            return std::max(0.0, std::chrono::duration<double>(b - a).count());
+        };
+        e.m.exitCode = r.exitCode;
+        if (t && t->started) {
+            e.m.extractSec = secs(std::max(t->start, e.m.launchedAt), t->firstProgress);
+            e.m.downloadSec = secs(t->firstProgress, t->end);
+            e.m.bytes = t->bytes;
+            e.m.peakBps = t->peakBps;
+            end = t->end;
+        } else {
+            e.m.extractSec = secs(e.m.launchedAt, t ? t->end : end);
+            if (t) end = t->end;
+        }
+        e.m.totalSec = secs(e.m.launchedAt, end);
+    }
+
+    // Error class of a failed entry: from the ERROR line naming its video id,
+    // else from the last error when the job had only this entry.
+    static std::string failure_class(const PoolEntry &e, const std::vector<std::string> &errors, bool alone) {
+        for (auto &line : errors) {
+            // "ERROR: [extractor] <id>: message"
+            size_t b = line.find("] "), c = b == std::string::npos ? b : line.find(": ", b + 2);
+            if (c != std::string::npos && c > b + 2 && e.url.find(line.substr(b + 2, c - b - 2)) != std::string::npos)
+                return error_class(line);
+        }
+        return alone && !errors.empty() ? error_class(errors.back()) : "error";
+    }
+
+    void count_failure(const PoolEntry &e) {
+        std::lock_guard<std::mutex> lk(m_);
+        failures_[e.list + "\n" + e.url]++;
+    }
+
+    // Refreshes totals_ for the renderer; loop thread only, caller holds m_.
+    void publish_totals() {
+        PoolTotals t;
+        t.submitted = submitted_; t.done = done_; t.failed = failed_; t.queued = queue_.size();
+        t.converting = converting_.size(); t.waiting = post_.size();
+        t.limit = ctl_.limit(); t.maxJobs = ctl_.max(); t.rate = ctl_.rate();
+        t.adaptive = ctl_.adaptive(); t.paused = paused_;
+        totals_.store(t);
+    }
+
+    const Config &cfg_;
+    std::string ytdlp_, ff_;
+    std::string target_;        // transcode_target(), "" = no transcode stage
+    int transcodeJobs_ = 1;
+    bool inline_ = false;
+    ProcessEngine engine_;      // only touched by the loop thread, except wake()
+    std::thread loop_;
+    std::mutex m_;
+    std::condition_variable idle_;
+    std::deque<PoolEntry> queue_;
+    std::vector<std::unique_ptr<Job>> running_;
+    std::vector<Job*> started_;                         // launched, onState not yet called
+    std::deque<PoolEntry> post_;                        // downloaded, waiting for ffmpeg
+    std::unordered_map<std::string, int> failures_;     // "list\nurl" -> failed attempts
+    std::vector<std::unique_ptr<Transcode>> converting_;
+    std::vector<std::unique_ptr<Prefetch>> prefetching_;
+    std::vector<std::pair<PoolEntry, std::string>> rejected_;  // too big for the disk, with why
+    int prefetchJobs_ = 1;
+    size_t lookahead_ = 16, prefetched_ = 0, rejecting_ = 0;
+    uint64_t space_ = UINT64_MAX;                       // free_space() sample, taken at spaceAt_
+    std::chrono::steady_clock::time_point spaceAt_;
+    std::map<std::string,int> hostActive_;
+    struct CachedProfile { bool loaded = false; fs::file_time_type mtime; DownloadProfile profile; };
+    std::map<std::string, CachedProfile> profiles_;     // loop thread only, like tuners_
+    std::map<std::string, FragmentTuner> tuners_;       // lists with concurrent_fragments=auto
+    std::vector<JobStatus> slots_;
+    SeqSlot<PoolTotals> totals_;
+    ConcurrencyController ctl_;
+    std::chrono::steady_clock::time_point window_;
+    uint64_t windowBytes_ = 0;
+    int windowThrottled_ = 0;
+    size_t submitted_ = 0, done_ = 0, failed_ = 0;
+    bool paused_ = false, stopping_ = false;
+};
+
+// ---------- Metrics ----------
+// Every finished URL is appended to internals/metrics.jsonl as one JSON
+// object (times in seconds, speeds in bytes/s):
+//   {"time":"2026-01-02T03:04:05Z","list":"l","url":"u","ok":true,"exit":0,
+//    "post_exit":0,"convert":"remux","retries":0,"fragments":0,"stalls":0,
+//    "timeouts":0,"queue_s":0.0,"extract_s":1.2,"download_s":8.4,"post_s":0.3,
+//    "total_s":9.9,"bytes":52428800,"avg_bps":6241523,"peak_bps":7340032}
+// "convert" (none, remux, audio, recode) is only there with a target format;
+// "stalls" and "timeouts" count the watchdog kills before the final attempt.
+// With prometheus_file= set, counters and gauges are also rewritten there in
+// Prometheus text format every PROM_EXPORT_MS, for node_exporter's textfile
+// collector or similar.
+static const char METRICS_LOG[] = "internals/metrics.jsonl";
+static const int PROM_EXPORT_MS = 5000;
+
+static std::string json_escape(const std::string &s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') { out += '\\'; out += c; }
+        else if ((unsigned char)c < 0x20) { char b[8]; std::snprintf(b, sizeof(b), "\\u%04x", c); out += b; }
+        else out += c;
+    }
+    return out;
+}
+
+class RunMetrics {
+public:
+    explicit RunMetrics(const std::string &promFile) : prom_(promFile) {
+        ensure_dir("internals");
+        fd_ = fd_open_append(METRICS_LOG);
+        if (fd_ < 0) std::cerr << "[WARN] cannot open " << METRICS_LOG << ", job metrics are not saved\n";
+    }
+    ~RunMetrics() { if (fd_ >= 0) fd_close(fd_); }
+    RunMetrics(const RunMetrics&) = delete;
+    RunMetrics &operator=(const RunMetrics&) = delete;
+
+    // Loop thread only, like the pool callbacks that call it.
+    void record(const PoolEntry &e) {
+        const JobMetrics &m = e.m;
+        (e.ok ? ok_ : failed_)++;
+        bytes_ += m.bytes;
+        stalls_ += m.stalls;
+        timeouts_ += m.timeouts;
+        phase_[0] += m.queueSec; phase_[1] += m.extractSec; phase_[2] += m.downloadSec; phase_[3] += m.postSec;
+        latency_.push_back(m.totalSec);
+        if (fd_ < 0) return;
+        char stamp[32];
+        std::time_t now = std::time(nullptr);
+        std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+        char nums[384];
+        std::snprintf(nums, sizeof(nums),
+            "\"retries\":%d,\"fragments\":%d,\"stalls\":%d,\"timeouts\":%d,\"queue_s\":%.3f,\"extract_s\":%.3f,\"download_s\":%.3f,\"post_s\":%.3f,\"total_s\":%.3f,"
+            "\"bytes\":%llu,\"avg_bps\":%.0f,\"peak_bps\":%.0f}\n",
+            m.retries, m.fragments, m.stalls, m.timeouts, m.queueSec, m.extractSec, m.downloadSec, m.postSec, m.totalSec, (unsigned long long)m.bytes,
+            m.downloadSec > 0 ? m.bytes / m.downloadSec : 0.0, m.peakBps);
+        std::string line = std::string("{\"time\":\"") + stamp + "\",\"list\":\"" + json_escape(e.list) + "\",\"url\":\""
+            + json_escape(e.url) + "\",\"ok\":" + (e.ok ? "true" : "false") + ",\"exit\":" + std::to_string(m.exitCode)
+            + ",\"post_exit\":" + (m.postExitCode < 0 ? std::string("null") : std::to_string(m.postExitCode))
+            + (e.ok ? std::string() : ",\"error\":\"" + json_escape(e.error) + "\"")
+            + (m.conversion ? std::string(",\"convert\":\"") + m.conversion + "\"" : std::string()) + "," + nums;
+        if (!fd_write(fd_, line)) log_line(std::string("[WARN] Failed to write ") + METRICS_LOG, true);
+    }
+
+    // Rewrites the Prometheus file at most every PROM_EXPORT_MS unless forced.
+    void export_prom(const DownloadPool::Stats &st, bool force = false) {
+        if (prom_.empty()) return;
+        auto now = std::chrono::steady_clock::now();
+        if (!force && std::chrono::duration_cast<std::chrono::milliseconds>(now - lastExport_).count() < PROM_EXPORT_MS) return;
+        lastExport_ = now;
+        std::string tmp = prom_ + ".tmp";
+        {
+            std::ofstream f(tmp, std::ios::trunc);
+            if (!f) return;
+            f << "# HELP streamharvester_jobs_total URLs finished, by result.\n# TYPE streamharvester_jobs_total counter\n"
+              << "streamharvester_jobs_total{result=\"ok\"} " << ok_ << "\n"
+              << "streamharvester_jobs_total{result=\"failed\"} " << failed_ << "\n"
+              << "# HELP streamharvester_downloaded_bytes_total Bytes of finished URLs.\n# TYPE streamharvester_downloaded_bytes_total counter\n"
+              << "streamharvester_downloaded_bytes_total " << bytes_ << "\n"
+              << "# HELP streamharvester_phase_seconds_total Time finished URLs spent per phase.\n# TYPE streamharvester_phase_seconds_total counter\n";
+            static const char *phases[] = {"queue", "extract", "download", "convert"};
+            for (int i = 0; i < 4; ++i) f << "streamharvester_phase_seconds_total{phase=\"" << phases[i] << "\"} " << phase_[i] << "\n";
+            f << "# HELP streamharvester_watchdog_kills_total Jobs of finished URLs the watchdog killed, by reason.\n# TYPE streamharvester_watchdog_kills_total counter\n"
+              << "streamharvester_watchdog_kills_total{reason=\"stalled\"} " << stalls_ << "\n"
+              << "streamharvester_watchdog_kills_total{reason=\"timeout\"} " << timeouts_ << "\n";
+            f << "# HELP streamharvester_job_seconds Launch-to-done time per URL.\n# TYPE streamharvester_job_seconds summary\n"
+              << "streamharvester_job_seconds{quantile=\"0.5\"} " << percentile(0.5) << "\n"
+              << "streamharvester_job_seconds{quantile=\"0.95\"} " << percentile(0.95) << "\n"
+              << "streamharvester_job_seconds_sum " << sum(latency_) << "\n"
+              << "streamharvester_job_seconds_count " << latency_.size() << "\n";
+            auto gauge = [&](const char *name, const char *help, double v) {
+                f << "# HELP " << name << " " << help << "\n# TYPE " << name << " gauge\n" << name << " " << v << "\n";
+            };
+            gauge("streamharvester_queued", "URLs waiting for a download slot.", (double)st.queued);
+            gauge("streamharvester_active", "URLs being downloaded.", (double)st.active);
+            gauge("streamharvester_converting", "URLs waiting for or inside ffmpeg.", (double)st.converting);
+            gauge("streamharvester_job_limit", "Current limit of parallel yt-dlp processes.", st.limit);
+            gauge("streamharvester_download_rate_bytes", "Aggregate download rate over the last window.", st.rate);
+        }
+        if (!replace_file(tmp, prom_)) std::remove(tmp.c_str());
+    }
+
+    // "[STATS]" lines for the end of a run.
+    void print_summary() const {
+        size_t n = ok_ + failed_;
+        if (n == 0) return;
+        double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+        char buf[256];
+        std::snprintf(buf, sizeof(buf), "[STATS] %zu URLs: %zu ok, %zu failed | latency p50 %.1fs p95 %.1fs | %.1fMiB in %.1fs (%s)\n",
+                      n, ok_, failed_, percentile(0.5), percentile(0.95), bytes_ / 1048576.0, wall,
+                      format_bps(wall > 0 ? bytes_ / wall : 0).c_str());
+        std::cout << buf;
+        std::snprintf(buf, sizeof(buf), "[STATS] average per URL: queue %.1fs, extract %.1fs, download %.1fs, convert %.1fs\n",
+                      phase_[0] / n, phase_[1] / n, phase_[2] / n, phase_[3] / n);
+        std::cout << buf;
+        if (stalls_ || timeouts_) std::cout << "[STATS] watchdog kills: " << stalls_ << " stalled, " << timeouts_ << " timed out\n";
+    }
+
+private:
+    // Nearest-rank percentile of the launch-to-done times.
+    double percentile(double q) const {
+        if (latency_.empty()) return 0;
+        std::vector<double> v(latency_);
+        size_t k = (size_t)std::max(0.0, std::ceil(q * v.size()) - 1);
+        std::nth_element(v.begin(), v.begin() + k, v.end());
+        return v[k];
+    }
+    static double sum(const std::vector<double> &v) { double t = 0; for (double x : v) t += x; return t; }
+
+    std::string prom_;
+    int fd_ = -1;
+    size_t ok_ = 0, failed_ = 0, stalls_ = 0, timeouts_ = 0;
+    uint64_t bytes_ = 0;
+    double phase_[4] = {0, 0, 0, 0};     // queue, extract, download, convert
+    std::vector<double> latency_;
+    std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now(), lastExport_;
+};
+
+// ---------- Media dedup ----------
+// With dedup=1 every finished file is hashed on a background thread and
+// hardlinked into a content-addressed store, downloads/.media/<ab>/<hash>-<size>.
+// A later file with the same bytes is replaced by a hardlink to that copy, so
+// a video saved under two titles, or fetched by two lists, takes its space
+// once. Store entries no download links to any more are pruned at start.
+static const char MEDIA_STORE[] = "downloads/.media";
+static const uint64_t DEDUP_MIN_BYTES = 64 * 1024;   // smaller files are not worth a link
+
+// XXH64 with seed 0: streams at memory speed over the mapped file.
+static uint64_t content_hash(const char *p, size_t n) {
+    static const uint64_t P1 = 11400714785074694791ULL, P2 = 14029467366897019727ULL, P3 = 1609587929392839161ULL,
+                          P4 = 9650029242287828579ULL, P5 = 2870177450012600261ULL;
+    auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+    auto read64 = [](const char *q) { uint64_t v; std::memcpy(&v, q, 8); return v; };
+    auto read32 = [](const char *q) { uint32_t v; std::memcpy(&v, q, 4); return (uint64_t)v; };
+    auto mix = [&](uint64_t acc, uint64_t in) { return rotl(acc + in * P2, 31) * P1; };
+    const char *end = p + n;
+    uint64_t h;
+    if (n >= 32) {
+        uint64_t v1 = P1 + P2, v2 = P2, v3 = 0, v4 = 0 - P1;
+        for (; p + 32 <= end; p += 32) {
+            v1 = mix(v1, read64(p));
+            v2 = mix(v2, read64(p + 8));
+            v3 = mix(v3, read64(p + 16));
+            v4 = mix(v4, read64(p + 24));
+        }
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        for (uint64_t v : {v1, v2, v3, v4}) h = (h ^ mix(0, v)) * P1 + P4;
+    } else {
+        h = P5;
+    }
+    h += n;
+    for (; p + 8 <= end; p += 8) h = rotl(h ^ mix(0, read64(p)), 27) * P1 + P4;
+    if (p + 4 <= end) { h = rotl(h ^ (read32(p) * P1), 23) * P2 + P3; p += 4; }
+    for (; p < end; ++p) h = rotl(h ^ ((uint64_t)(unsigned char)*p * P5), 11) * P1;
+    h ^= h >> 33; h *= P2;
+    h ^= h >> 29; h *= P3;
+    return h ^ (h >> 32);
+}
+
+// Owns the hashing thread; add() only queues, so callbacks on the pool's loop
+// thread never wait for a multi-GB read.
+class MediaDedup {
+public:
+    explicit MediaDedup(bool enabled) : enabled_(enabled) {
+        if (enabled_) worker_ = std::thread([this] { run(); });
+    }
+    ~MediaDedup() { finish(); }
+    MediaDedup(const MediaDedup&) = delete;
+    MediaDedup &operator=(const MediaDedup&) = delete;
+
+    void add(const std::string &file) {
+        if (!enabled_ || file.empty()) return;
+        { std::lock_guard<std::mutex> lk(m_); queue_.push_back(file); }
+        cv_.notify_one();
+    }
+
+    // Hashes what is still queued and stops the thread.
+    void finish() {
+        { std::lock_guard<std::mutex> lk(m_); stop_ = true; }
+        cv_.notify_all();
+        if (worker_.joinable()) worker_.join();
+    }
+
+    // " dedup=N reclaimed=B" for the daemon's status line.
+    std::string status() const {
+        if (!enabled_) return "";
+        std::lock_guard<std::mutex> lk(m_);
+        return " dedup=" + std::to_string(linked_) + " reclaimed=" + std::to_string(reclaimed_);
+    }
+
+    void print_summary() const {
+        std::lock_guard<std::mutex> lk(m_);
+        if (!enabled_ || hashed_ == 0) return;
+        char buf[256];
+        std::snprintf(buf, sizeof(buf), "[DEDUP] %zu files hashed (%.1fMiB in %.1fs), %zu duplicates hardlinked, %.1fMiB reclaimed",
+                      hashed_, hashedBytes_ / 1048576.0, hashSec_, linked_, reclaimed_ / 1048576.0);
+        std::cout << buf << (pruned_ ? ", " + std::to_string(pruned_) + " stale store entries pruned" : "") << "\n";
+    }
+
+private:
+    void run() {
+        prune();
+        std::unique_lock<std::mutex> lk(m_);
+        for (;;) {
+            cv_.wait(lk, [this] { return stop_ || !queue_.empty(); });
+            if (queue_.empty()) return;
+            std::string file = std::move(queue_.front());
+            queue_.pop_front();
+            lk.unlock();
+            if (!failed_) process(file);
+            lk.lock();
+        }
+    }
+
+    // Drops store entries whose downloads were all deleted or moved away.
+    void prune() {
+        std::error_code ec;
+        size_t n = 0;
+        for (fs::recursive_directory_iterator it(MEDIA_STORE, ec), end; !ec && it != end; it.increment(ec))
+            if (it->is_regular_file(ec) && fs::hard_link_count(it->path(), ec) == 1 && fs::remove(it->path(), ec)) n++;
+        std::lock_guard<std::mutex> lk(m_);
+        pruned_ = n;
+    }
+
+    void process(const std::string &file) {
+        std::error_code ec;
+        uint64_t size = fs::file_size(file, ec);
+        // more than one link: already in the store, from this run or an earlier one
+        if (ec || size < DEDUP_MIN_BYTES || fs::hard_link_count(file, ec) != 1) return;
+        auto t0 = std::chrono::steady_clock::now();
+        uint64_t h;
+        {
+            MappedFile mf(file);
+            if ((uint64_t)(mf.end() - mf.begin()) != size) return;
+            h = content_hash(mf.begin(), (size_t)size);
+        }
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            hashed_++; hashedBytes_ += size; hashSec_ += secs;
+        }
+        char name[48];
+        std::snprintf(name, sizeof(name), "%016llx-%llu", (unsigned long long)h, (unsigned long long)size);
+        fs::path store = fs::path(MEDIA_STORE) / std::string(name, 2) / name;
+        if (!fs::exists(store, ec)) {
+            fs::create_directories(store.parent_path(), ec);
+            fs::create_hard_link(file, store, ec);
+            if (!ec) return;
+            // another instance got there first: compare against its copy below
+            if (ec != std::errc::file_exists) {
+                log_line("[WARN] dedup off for this run, cannot hardlink into " + std::string(MEDIA_STORE) + ": " + ec.message(), true);
+                failed_ = true;
+                return;
+            }
+        }
+        if (!same_bytes(file, store.string())) return;
+        std::string tmp = file + ".dedup.tmp";
+        fs::remove(tmp, ec);
+        fs::create_hard_link(store, tmp, ec);
+        if (ec || !replace_file(tmp, file)) {
+            fs::remove(tmp, ec);
+            log_line("[WARN] dedup: could not replace " + file, true);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            linked_++; reclaimed_ += size;
+        }
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), "%.1fMiB", size / 1048576.0);
+        log_line("[DEDUP] " + fs::path(file).filename().string() + ": identical to an earlier download, " + buf + " reclaimed");
+    }
+
+    // A hash match is only trusted once the bytes agree.
+    static bool same_bytes(const std::string &a, const std::string &b) {
+        MappedFile ma(a), mb(b);
+        size_t n = ma.end() - ma.begin();
+        return n == (size_t)(mb.end() - mb.begin()) && n > 0 && std::memcmp(ma.begin(), mb.begin(), n) == 0;
+    }
+
+    bool enabled_;
+    std::atomic<bool> failed_{false};
+    mutable std::mutex m_;
+    std::condition_variable cv_;
+    std::deque<std::string> queue_;
+    bool stop_ = false;
+    size_t hashed_ = 0, linked_ = 0, pruned_ = 0;
+    uint64_t hashedBytes_ = 0, reclaimed_ = 0;
+    double hashSec_ = 0;
+    std::thread worker_;
+};
+
+// ---------- Media catalog ----------
+// What each finished download produced, one line per file in
+// internals/catalog.tsv, appended as it completes:
+//   <unix time>\t<canonical key>\t<id>\t<bytes>\t<seconds>\t<ext>\t<vcodec>/<acodec>\t<path>\t<title>
+// Lookups ("find") go through internals/catalog.idx, three sorted arrays over
+// the lines it covers: (key hash, offset), (id hash, offset) and offsets in
+// case-folded title order. A query is a few binary searches over two mapped
+// files; lines appended after the index was built are scanned, and once there
+// are more than CATALOG_REINDEX of them the index is rebuilt first.
+static const char CATALOG_PATH[] = "internals/catalog.tsv";
+static const char CATALOG_INDEX[] = "internals/catalog.idx";
+static const size_t CATALOG_REINDEX = 4096;
+
+struct CatalogEntry {
+    int64_t time = 0;
+    std::string key, id, ext, codecs, path, title;
+    uint64_t bytes = 0;
+    double duration = 0;
+};
+
+// The line starting at p; false when it has fewer than nine fields.
+static bool parse_catalog_line(const char *p, const char *end, CatalogEntry &e) {
+    const char *eol = (const char*)std::memchr(p, '\n', end - p);
+    if (!eol) eol = end;
+    std::string f[9];
+    for (int i = 0; i < 9; ++i) {
+        const char *tab = i < 8 ? (const char*)std::memchr(p, '\t', eol - p) : nullptr;
+        if (i < 8 && !tab) return false;
+        f[i].assign(p, tab ? tab : eol);
+        p = tab ? tab + 1 : eol;
+    }
+    e.time = std::atoll(f[0].c_str());
+    e.key = f[1]; e.id = f[2];
+    e.bytes = std::strtoull(f[3].c_str(), nullptr, 10);
+    e.duration = std::atof(f[4].c_str());
+    e.ext = f[5]; e.codecs = f[6]; e.path = f[7]; e.title = f[8];
     return true;
 }
 
+// [b, e) of the title of the line at p (the text after its eighth tab).
+static void catalog_title(const char *p, const char *end, const char *&b, const char *&e) {
+    e = (const char*)std::memchr(p, '\n', end - p);
+    if (!e) e = end;
+    b = p;
+    for (int i = 0; i < 8 && b < e; ++i) {
+        const char *tab = (const char*)std::memchr(b, '\t', e - b);
+        b = tab ? tab + 1 : e;
+    }
+}
+
+// Order of [ab, ae) against [bb, be), like memcmp but with ASCII letters
+// folded to lowercase (not the locale's: the index is shared); with prefix,
+// only the first be - bb bytes of a count.
+static int fold_compare(const char *ab, const char *ae, const char *bb, const char *be, bool prefix) {
+    auto fold = [](char c) { return (unsigned char)(c >= 'A' && c <= 'Z' ? c + 32 : c); };
+    for (; ab < ae && bb < be; ++ab, ++bb) {
+        unsigned char x = fold(*ab), y = fold(*bb);
+        if (x != y) return x < y ? -1 : 1;
+    }
+    if (bb == be) return prefix || ab == ae ? 0 : 1;
+    return -1;
+}
+
+// Appends to internals/catalog.tsv; like the archive, one write per line so
+// several instances can share the file.
+class MediaCatalog {
+public:
+    static MediaCatalog &instance() { static MediaCatalog c; return c; }
+
+    void add(const PoolEntry &e) {
+        if (e.file.empty()) return;
+        std::error_code ec;
+        uint64_t bytes = fs::file_size(e.file, ec);
+        if (ec) bytes = 0;
+        std::string ext = fs::path(e.file).extension().string();
+        if (!ext.empty()) ext.erase(0, 1);
+        char num[64];
+        std::snprintf(num, sizeof(num), "%lld\t", (long long)std::time(nullptr));
+        std::string line = num + clean(canonical_key(e.url)) + "\t" + clean(e.id) + "\t" + std::to_string(bytes) + "\t";
+        std::snprintf(num, sizeof(num), "%.0f\t", e.duration);
+        line += num + clean(ext) + "\t" + clean(e.vcodec.empty() ? "?" : e.vcodec) + "/" + clean(e.acodec.empty() ? "?" : e.acodec)
+              + "\t" + clean(e.file) + "\t" + clean(e.title) + "\n";
+        std::lock_guard<std::mutex> lk(m_);
+        if (fd_ < 0) fd_ = fd_open_append(CATALOG_PATH);
+        if (fd_ < 0 || !fd_write(fd_, line)) log_line("[WARN] Failed to write media catalog", true);
+    }
+
+private:
+    MediaCatalog() = default;
+    ~MediaCatalog() { if (fd_ >= 0) fd_close(fd_); }
+    static std::string clean(std::string s) {
+        for (auto &c : s) if (c == '\t' || c == '\n' || c == '\r') c = ' ';
+        return s;
+    }
+    std::mutex m_;
+    int fd_ = -1;
+};
+
+// Read side: maps the catalog and its index, rebuilding the index when it is
+// missing, does not match the catalog, or lags too far behind it.
+class CatalogReader {
+public:
+    CatalogReader() : cat_(CATALOG_PATH) {
+        begin_ = cat_.begin();
+        // a last line without '\n' is still being written
+        const char *nl = begin_ ? last_newline(begin_, cat_.end()) : nullptr;
+        end_ = nl ? nl + 1 : begin_;
+        if (!open_index()) rebuild();
+    }
+
+    size_t size() const { return count_ + tail_.size(); }
+    bool rebuilt() const { return rebuilt_; }
+
+    std::vector<CatalogEntry> by_key(const std::string &key) const { return by_hash(byKey_, key, &CatalogEntry::key); }
+    std::vector<CatalogEntry> by_id(const std::string &id) const { return by_hash(byId_, id, &CatalogEntry::id); }
+
+    // Entries whose title starts with prefix, ignoring ASCII case, in title order.
+    std::vector<CatalogEntry> by_title(const std::string &prefix, size_t limit) const {
+        const char *pb = prefix.data(), *pe = pb + prefix.size();
+        auto cmp = [&](uint64_t off) {
+            const char *b, *e;
+            catalog_title(begin_ + off, end_, b, e);
+            return fold_compare(b, e, pb, pe, true);
+        };
+        const uint64_t *lo = std::partition_point(byTitle_, byTitle_ + count_, [&](uint64_t off) { return cmp(off) < 0; });
+        std::vector<CatalogEntry> out;
+        for (; lo < byTitle_ + count_ && out.size() < limit && cmp(*lo) == 0; ++lo) add(*lo, out);
+        for (uint64_t off : tail_) {
+            if (out.size() >= limit) break;
+            if (cmp(off) == 0) add(off, out);
+        }
+        return out;
+    }
+
+private:
+    struct Header { char magic[8]; uint64_t covered, count; };
+    struct Slot {
+        uint64_t hash, offset;
+        bool operator<(const Slot &o) const { return hash < o.hash || (hash == o.hash && offset < o.offset); }
+    };
+
+    static const char *last_newline(const char *b, const char *e) {
+        while (e > b && e[-1] != '\n') --e;
+        return e > b ? e - 1 : nullptr;
+    }
+
+    // Uses catalog.idx if it describes a prefix of the catalog; collects the
+    // lines after that prefix.
+    bool open_index() {
+        idx_.reset(new MappedFile(CATALOG_INDEX));
+        const char *b = idx_->begin();
+        size_t n = idx_->end() - b;
+        if (!b || n < sizeof(Header)) return false;
+        Header h;
+        std::memcpy(&h, b, sizeof(h));
+        if (std::memcmp(h.magic, "SHCAT1\n", 8) != 0 || n != sizeof(Header) + h.count * (2 * sizeof(Slot) + sizeof(uint64_t))
+            || h.covered > (uint64_t)(end_ - begin_) || (h.covered && begin_[h.covered - 1] != '\n'))
+            return false;
+        for (const char *p = begin_ + h.covered; p < end_; p = (const char*)std::memchr(p, '\n', end_ - p) + 1) {
+            if (tail_.size() >= CATALOG_REINDEX) return false;
+            tail_.push_back(p - begin_);
+        }
+        count_ = h.count;
+        byKey_ = (const Slot*)(b + sizeof(Header));
+        byId_ = byKey_ + count_;
+        byTitle_ = (const uint64_t*)(byId_ + count_);
+        return true;
+    }
+
+    // Sorts every complete line into the three arrays and writes them out; a
+    // failed write only costs the next query another rebuild.
+    void rebuild() {
+        rebuilt_ = true;
+        tail_.clear();
+        keys_.clear(); ids_.clear(); titles_.clear();
+        for (const char *p = begin_; p < end_;) {
+            const char *eol = (const char*)std::memchr(p, '\n', end_ - p);
+            const char *t1 = (const char*)std::memchr(p, '\t', eol - p);
+            const char *t2 = t1 ? (const char*)std::memchr(t1 + 1, '\t', eol - t1 - 1) : nullptr;
+            const char *t3 = t2 ? (const char*)std::memchr(t2 + 1, '\t', eol - t2 - 1) : nullptr;
+            if (t3) {
+                uint64_t off = p - begin_;
+                keys_.push_back({hash64(std::string(t1 + 1, t2)), off});
+                ids_.push_back({hash64(std::string(t2 + 1, t3)), off});
+                titles_.push_back(off);
+            }
+            p = eol + 1;
+        }
+        std::sort(keys_.begin(), keys_.end());
+        std::sort(ids_.begin(), ids_.end());
+        // titles sort on a folded copy, first by their leading 8 bytes as one
+        // big-endian number, which settles most comparisons without a memcmp
+        struct Title { uint64_t head, off; size_t at, len; };
+        std::vector<Title> order(titles_.size());
+        std::string folded;
+        for (size_t i = 0; i < order.size(); ++i) {
+            const char *b, *e;
+            catalog_title(begin_ + titles_[i], end_, b, e);
+            Title &t = order[i];
+            t.off = titles_[i]; t.at = folded.size(); t.len = e - b;
+            t.head = 0;
+            for (size_t k = 0; k < 8; ++k) {
+                unsigned char c = b + k < e ? (unsigned char)b[k] : 0;
+                c = c >= 'A' && c <= 'Z' ? c + 32 : c;
+                t.head = t.head << 8 | c;
+            }
+            for (; b < e; ++b) folded += (char)(*b >= 'A' && *b <= 'Z' ? *b + 32 : *b);
+        }
+        std::sort(order.begin(), order.end(), [&](const Title &a, const Title &b) {
+            if (a.head != b.head) return a.head < b.head;
+            size_t n = std::min(a.len, b.len);
+            int c = n > 8 ? std::memcmp(folded.data() + a.at + 8, folded.data() + b.at + 8, n - 8) : 0;
+            if (c != 0) return c < 0;
+            return a.len != b.len ? a.len < b.len : a.off < b.off;
+        });
+        std::vector<uint64_t> sorted(order.size());
+        for (size_t i = 0; i < order.size(); ++i) sorted[i] = order[i].off;
+        titles_.swap(sorted);
+        count_ = keys_.size();
+        byKey_ = keys_.data(); byId_ = ids_.data(); byTitle_ = titles_.data();
+
+        Header h{{'S', 'H', 'C', 'A', 'T', '1', '\n', 0}, (uint64_t)(end_ - begin_), count_};
+        std::string tmp = std::string(CATALOG_INDEX) + ".tmp";
+        {
+            std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+            f.write((const char*)&h, sizeof(h));
+            f.write((const char*)keys_.data(), (std::streamsize)(keys_.size() * sizeof(Slot)));
+            f.write((const char*)ids_.data(), (std::streamsize)(ids_.size() * sizeof(Slot)));
+            f.write((const char*)titles_.data(), (std::streamsize)(titles_.size() * sizeof(uint64_t)));
+            if (!f) { f.close(); std::remove(tmp.c_str()); return; }
+        }
+        idx_.reset();   // Windows cannot replace a mapped file
+        if (!replace_file(tmp, CATALOG_INDEX)) std::remove(tmp.c_str());
+    }
+
+    std::vector<CatalogEntry> by_hash(const Slot *slots, const std::string &s, std::string CatalogEntry::*field) const {
+        std::vector<CatalogEntry> out;
+        uint64_t h = hash64(s);
+        const Slot *lo = std::lower_bound(slots, slots + count_, Slot{h, 0});
+        for (; lo < slots + count_ && lo->hash == h; ++lo) add(lo->offset, out);
+        for (uint64_t off : tail_) add(off, out);
+        out.erase(std::remove_if(out.begin(), out.end(), [&](const CatalogEntry &e) { return e.*field != s; }), out.end());
+        std::sort(out.begin(), out.end(), [](const CatalogEntry &a, const CatalogEntry &b) { return a.time < b.time; });
+        return out;
+    }
+
+    void add(uint64_t off, std::vector<CatalogEntry> &out) const {
+        CatalogEntry e;
+        if (parse_catalog_line(begin_ + off, end_, e)) out.push_back(std::move(e));
+    }
+
+    MappedFile cat_;
+    std::unique_ptr<MappedFile> idx_;
+    const char *begin_ = nullptr, *end_ = nullptr;   // complete lines of the catalog
+    size_t count_ = 0;
+    const Slot *byKey_ = nullptr, *byId_ = nullptr;
+    const uint64_t *byTitle_ = nullptr;
+    std::vector<uint64_t> tail_;                     // lines past the index
+    std::vector<Slot> keys_, ids_;                   // a rebuilt index, in memory
+    std::vector<uint64_t> titles_;
+    bool rebuilt_ = false;
+};
+
+static const size_t CATALOG_TITLE_MATCHES = 50;
+
+// "StreamHarvester find <id | url | title prefix>": where a download went.
+// Something with "://" or a '/' is a URL and matches by canonical key;
+// anything else is tried as a video id, then as the start of a title.
+static int catalog_find(const std::string &query) {
+    auto t0 = std::chrono::steady_clock::now();
+    CatalogReader cat;
+    std::vector<CatalogEntry> hits;
+    const char *how = "url";
+    if (query.find("://") != std::string::npos || query.find('/') != std::string::npos) hits = cat.by_key(canonical_key(query));
+    else {
+        how = "id";
+        hits = cat.by_id(query);
+        if (hits.empty()) { how = "title"; hits = cat.by_title(query, CATALOG_TITLE_MATCHES + 1); }
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    if (hits.empty()) {
+        std::cerr << "[!] Nothing in the catalog (" << cat.size() << " files) matches '" << query << "'\n";
+        return 1;
+    }
+    for (size_t i = 0; i < hits.size() && i < CATALOG_TITLE_MATCHES; ++i) {
+        const CatalogEntry &e = hits[i];
+        std::error_code ec;
+        time_t t = (time_t)e.time;
+        char stamp[32], line[160];
+        std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&t));
+        int d = (int)e.duration;
+        std::snprintf(line, sizeof(line), "%s  %.1fMiB  %d:%02d:%02d  %s %s  ", stamp, e.bytes / 1048576.0, d / 3600, d / 60 % 60, d % 60,
+                      e.ext.c_str(), e.codecs.c_str());
+        std::cout << line << e.path << (fs::exists(e.path, ec) ? "" : "  (missing)") << "\n"
+                  << "    " << e.key << (e.title.empty() ? "" : " \"" + e.title + "\"") << "\n";
+    }
+    if (hits.size() > CATALOG_TITLE_MATCHES) std::cout << "[...] more titles start with '" << query << "'\n";
+    char buf[96];
+    std::snprintf(buf, sizeof(buf), "[INFO] %zu match(es) by %s among %zu files in %.1fms%s\n", std::min(hits.size(), CATALOG_TITLE_MATCHES), how,
+                  cat.size(), ms, cat.rebuilt() ? " (index rebuilt)" : "");
+    std::cout << buf;
+    return 0;
+}
+
+// ---------- List leases ----------
+// Several instances (processes on one host, or hosts sharing internals/ over
+// NFS) drain one list together by leasing its entries in small batches. The
+// leases live in internals/lists/<name>.leases, one line per entry, keyed by
+// canonical URL and only touched under the list's ListLock:
+//   <expiry, unix seconds>\t<owner>\t<canonical key>
+// An instance renews its leases while their entries are queued, downloading
+// or converting, and drops each one once the journal has the outcome. Leases
+// of an instance that died run out after LEASE_S and the next claim takes
+// their entries over.
+// Dropped leases leave the file with the next write (a claim, or the renewal
+// at most LEASE_RENEW_S later), not one rewrite per finished entry; the
+// journal already keeps other instances off those entries meanwhile.
+static const int64_t LEASE_S = 120;
+static const int64_t LEASE_RENEW_S = 30;
+
+// host:pid:start time, naming this instance in lease files.
+static std::string instance_id() {
+    char host[256] = "";
+#ifdef _WIN32
+    DWORD n = sizeof(host);
+    if (!GetComputerNameA(host, &n)) host[0] = 0;
+    long pid = (long)GetCurrentProcessId();
+#else
+    if (gethostname(host, sizeof(host) - 1) != 0) host[0] = 0;
+    long pid = (long)getpid();
+#endif
+    return std::string(host[0] ? host : "localhost") + ":" + std::to_string(pid) + ":" + std::to_string((long long)std::time(nullptr));
+}
+
+class ListLeases {
+public:
+    // What claim() does with an entry no live lease covers.
+    enum class Claim { Take, Skip, Done };
+
+    ListLeases(const std::string &name, ListJournal &journal)
+        : name_(name), path_(lists_dir() + "/" + name + ".leases"), owner_(instance_id()), journal_(journal) {}
+    ~ListLeases() { release_all(); }
+    ListLeases(const ListLeases&) = delete;
+    ListLeases &operator=(const ListLeases&) = delete;
+
+    // Walks the list with the journal and the archive re-read, so entries
+    // other instances finished or are backing off are seen as such, and
+    // leases up to max of the entries for which admit() says Take. Done
+    // entries (duplicates, already downloaded) are journaled as finished.
+    std::vector<std::string> claim(size_t max, const std::function<Claim(const std::string &url)> &admit) {
+        ListLock lock(name_);
+        std::lock_guard<std::mutex> lk(m_);
+        journal_.reload();
+        DownloadArchive::instance().refresh();
+        int64_t now = (int64_t)std::time(nullptr);
+        auto leases = read(now);
+        std::vector<std::string> out, done;
+        elsewhere_ = 0;
+        ListCursor cur(name_);
+        for (std::string u; out.size() < max && cur.next(u);) {
+            std::string key = canonical_key(u);
+            auto it = leases.find(key);
+            if (it != leases.end()) { elsewhere_ += it->second.owner != owner_; continue; }
+            Claim c = admit(u);
+            if (c == Claim::Done) done.push_back(u);
+            if (c != Claim::Take) continue;
+            leases[key] = {now + LEASE_S, owner_};
+            mine_.insert(key);
+            out.push_back(u);
+        }
+        if (!done.empty() && !journal_.record_done_all(done)) log_line("[WARN] Failed to journal skipped URLs", true);
+        write(leases);
+        lastRenew_ = now;
+        return out;
+    }
+
+    // Leases one URL; false when another instance holds it.
+    bool take(const std::string &url) {
+        ListLock lock(name_);
+        std::lock_guard<std::mutex> lk(m_);
+        int64_t now = (int64_t)std::time(nullptr);
+        auto leases = read(now);
+        std::string key = canonical_key(url);
+        auto it = leases.find(key);
+        if (it != leases.end() && it->second.owner != owner_) return false;
+        leases[key] = {now + LEASE_S, owner_};
+        mine_.insert(key);
+        return write(leases);
+    }
+
+    // Drops the lease on a URL whose outcome is journaled; the file catches
+    // up with the next write.
+    void release(const std::string &url) {
+        std::lock_guard<std::mutex> lk(m_);
+        released_ |= mine_.erase(canonical_key(url)) > 0;
+    }
+
+    void release_all() {
+        ListLock lock(name_);
+        std::lock_guard<std::mutex> lk(m_);
+        if (mine_.empty() && !released_) return;
+        mine_.clear();
+        write(read((int64_t)std::time(nullptr)));
+    }
+
+    // Extends this instance's leases and writes out released ones, at most
+    // every LEASE_RENEW_S.
+    void renew() {
+        int64_t now = (int64_t)std::time(nullptr);
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if ((mine_.empty() && !released_) || now - lastRenew_ < LEASE_RENEW_S) return;
+        }
+        ListLock lock(name_);
+        std::lock_guard<std::mutex> lk(m_);
+        write(read(now));
+        lastRenew_ = now;
+    }
+
+    // Entries the last claim() found leased by other instances.
+    size_t leased_elsewhere() { std::lock_guard<std::mutex> lk(m_); return elsewhere_; }
+
+private:
+    struct Lease { int64_t expiry = 0; std::string owner; };
+
+    // The live leases, with this instance's own ones extended to now +
+    // LEASE_S and the expired ones of others dropped; caller holds the lock
+    // and m_. An own lease another instance took over after it ran out
+    // (this one stalled for LEASE_S) is given up.
+    std::map<std::string, Lease> read(int64_t now) {
+        std::map<std::string, Lease> leases;
+        size_t reclaimed = 0;
+        std::ifstream f(path_);
+        std::string line;
+        while (std::getline(f, line)) {
+            size_t a = line.find('\t'), b = a == std::string::npos ? a : line.find('\t', a + 1);
+            if (b == std::string::npos) continue;
+            Lease l;
+            l.expiry = std::atoll(line.c_str());
+            l.owner = line.substr(a + 1, b - a - 1);
+            if (l.owner == owner_) continue;   // rebuilt from mine_ below
+            if (l.expiry <= now) { reclaimed++; continue; }
+            leases[line.substr(b + 1)] = l;
+        }
+        if (reclaimed) log_line("[LEASE] " + std::to_string(reclaimed) + " expired leases on '" + name_ + "' released");
+        for (auto it = mine_.begin(); it != mine_.end();) {
+            auto l = leases.find(*it);
+            if (l != leases.end()) {
+                log_line("[LEASE] " + *it + " was taken over by " + l->second.owner, true);
+                it = mine_.erase(it);
+                continue;
+            }
+            leases[*it] = {now + LEASE_S, owner_};
+            ++it;
+        }
+        return leases;
+    }
+
+    bool write(const std::map<std::string, Lease> &leases) {
+        released_ = false;
+        if (leases.empty()) { std::remove(path_.c_str()); return true; }
+        std::string out, tmp = path_ + ".tmp";
+        for (auto &kv : leases) out += std::to_string(kv.second.expiry) + "\t" + kv.second.owner + "\t" + kv.first + "\n";
+        {
+            std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+            if (!(f << out)) return false;
+        }
+        if (!replace_file(tmp, path_)) { std::remove(tmp.c_str()); return false; }
+        return true;
+    }
+
+    std::string name_, path_, owner_;
+    ListJournal &journal_;
+    std::unordered_set<std::string> mine_;   // canonical keys leased by this instance
+    bool released_ = false;                  // the file still lists leases dropped from mine_
+    size_t elsewhere_ = 0;
+    int64_t lastRenew_ = 0;
+    std::mutex m_;
+};
+
 // ---------- Download + cleanup ----------
+// Journal records folded back into the list file during a run.
+static const size_t JOURNAL_COMPACT_EVERY = 256;
+// A failed URL waits RETRY_BASE_S before its next attempt, doubling each time
+// up to RETRY_MAX_S. Permanent errors, and the RETRY_MAX_ATTEMPTS-th failure,
+// move it to the quarantine list instead.
+static const int64_t RETRY_BASE_S = 60;
+static const int64_t RETRY_MAX_S = 6 * 3600;
+static const int RETRY_MAX_ATTEMPTS = 8;
+
+static std::string format_duration(int64_t s) {
+    if (s < 120) return std::to_string(s) + "s";
+    if (s < 7200) return std::to_string(s / 60) + "m";
+    return std::to_string(s / 3600) + "h";
+}
+
+// Persists the outcome of a failed attempt. Returns the seconds until the
+// entry is eligible again, or -1 when it was quarantined.
+static int64_t record_failure(ListJournal &journal, const PoolEntry &e) {
+    UrlRecord r = journal.state(e.url);
+    if (e.error == "canceled") {   // not the URL's fault
+        r.state = UrlState::Queued;
+        journal.set_state(e.url, r);
+        return 0;
+    }
+    r.attempts++;
+    r.error = e.error.empty() ? "error" : e.error;
+    std::string why = " (" + r.error + ", attempt " + std::to_string(r.attempts) + ")";
+    if (is_permanent_error(r.error) || r.attempts >= RETRY_MAX_ATTEMPTS) {
+        if (journal.quarantine(e.url, r.error)) {
+            log_line("[QUARANTINE] " + e.url + why + " -> list '" + quarantine_list(e.list) + "'");
+            return -1;
+        }
+        log_line("[WARN] Failed to quarantine " + e.url, true);
+    }
+    int64_t delay = std::min(RETRY_MAX_S, RETRY_BASE_S << std::min(r.attempts - 1, 20));
+    r.state = UrlState::Failed;
+    r.nextRetry = (int64_t)std::time(nullptr) + delay;
+    journal.set_state(e.url, r);
+    log_line("[RETRY] " + e.url + why + ", eligible again in " + format_duration(delay));
+    return delay;
+}
+
+// Keeps the persisted state in step with the pool.
+static void record_state(ListJournal &journal, const PoolEntry &e, UrlState st) {
+    UrlRecord r = journal.state(e.url);
+    r.state = st;
+    journal.set_state(e.url, r);
+}
+
+// What --flat-playlist found under one collection URL.
+struct Expansion {
+    std::vector<std::string> entries;
+    std::string error;      // last ERROR line
+    bool ok = false;        // the listing succeeded, or found something
+};
+
+// Collections nested this deep (a channel's tabs, then their playlists) are
+// followed; deeper ones are kept as entries.
+static const int EXPAND_DEPTH = 2;
+
+// Lists every collection in urls with up to `parallel` yt-dlp runs at once,
+// following entries that are collections themselves. Entry i of the result
+// holds the videos found under urls[i].
+static std::vector<Expansion> expand_collections(const std::string &ytdlp, const std::vector<std::string> &urls, int parallel) {
+    struct Task { size_t root; std::string url; int depth; };
+    std::vector<Expansion> out(urls.size());
+    std::deque<Task> todo;
+    for (size_t i = 0; i < urls.size(); ++i) todo.push_back({i, urls[i], 0});
+    std::unordered_set<std::string> visited(urls.begin(), urls.end());
+    ProcessEngine engine;
+    int running = 0;
+    while (!todo.empty() || running > 0) {
+        while (running < std::max(1, parallel) && !todo.empty()) {
+            Task t = todo.front();
+            todo.pop_front();
+            std::vector<std::string> args;
+            build_yt_dlp_expand_cmd(ytdlp, t.url, args);
+            auto found = std::make_shared<std::vector<std::string>>();
+            int id = engine.spawn(args,
+                [&out, t, found](const std::string &line, bool) {
+                    std::string l = trim(line);
+                    if (starts_with(l, "ERROR")) out[t.root].error = l;
+                    else if (l.find("://") != std::string::npos) found->push_back(l);
+                },
+                [&, t, found](const ChildResult &r) {
+                    running--;
+                    Expansion &x = out[t.root];
+                    if (t.depth == 0) x.ok = r.exitCode == 0;
+                    if (!found->empty()) x.ok = true;
+                    for (auto &e : *found) {
+                        if (t.depth < EXPAND_DEPTH && is_collection_url(e)) {
+                            if (visited.insert(e).second) todo.push_back({t.root, e, t.depth + 1});
+                        } else x.entries.push_back(e);
+                    }
+                });
+            if (id < 0) { out[t.root].error = "failed to start " + ytdlp; continue; }
+            running++;
+        }
+        if (running > 0) engine.poll_once(250);
+    }
+    return out;
+}
+
+struct ExpandStats { size_t collections = 0, added = 0, known = 0, failed = 0; };
+
+// Replaces the playlist and channel URLs of a list by their entries: new ones
+// are appended to the list (deduplicated against it and the archive, like
+// import_urls), then the collection is journaled as done. A collection that
+// could not be listed is recorded as a failed attempt, so it backs off or is
+// quarantined like any other URL; one still backing off is left alone. The
+// append happens under the list lock, skipping collections another instance
+// expanded meanwhile.
+static ExpandStats expand_list(const std::string &name, ListJournal &journal, const std::string &ytdlp, int parallel,
+                               std::vector<std::string> *added = nullptr) {
+    ExpandStats st;
+    std::vector<std::string> roots;
+    int64_t now = (int64_t)std::time(nullptr);
+    journal.reload();
+    ListCursor cur(name);
+    for (std::string u; cur.next(u);) {
+        if (!is_collection_url(u)) continue;
+        UrlRecord r = journal.state(u);
+        if ((r.state != UrlState::Failed || r.nextRetry <= now) && std::find(roots.begin(), roots.end(), u) == roots.end())
+            roots.push_back(u);
+    }
+    if (roots.empty()) return st;
+    log_line("[EXPAND] Listing " + std::to_string(roots.size()) + " playlists/channels of '" + name + "'...");
+    std::vector<Expansion> found = expand_collections(ytdlp, roots, parallel);
+    ListLock lock(name);
+    std::unordered_set<uint64_t> listed;
+    std::unordered_set<std::string> pending;   // roots still listed
+    ListCursor still(name);
+    for (std::string u; still.next(u);) {
+        if (is_collection_url(u)) pending.insert(u);
+        else listed.insert(hash64(canonical_key(u)));
+    }
+    std::ofstream out(list_path(name), std::ios::app);
+    auto &archive = DownloadArchive::instance();
+    std::vector<std::string> done;
+    for (size_t i = 0; i < roots.size(); ++i) {
+        if (!pending.count(roots[i])) continue;
+        if (!found[i].ok) {
+            PoolEntry e;
+            e.list = name; e.url = roots[i];
+            e.error = found[i].error.empty() ? "error" : error_class(found[i].error);
+            log_line("[FAIL] cannot list " + roots[i] + " (" + e.error + ")", true);
+            record_failure(journal, e);
+            st.failed++;
+            continue;
+        }
+        size_t n = 0;
+        for (auto &u : found[i].entries) {
+            std::string key = canonical_key(u);
+            if (!listed.insert(hash64(key)).second || archive.contains(key)) { st.known++; continue; }
+            out << u << '\n';
+            if (added) added->push_back(u);
+            n++;
+        }
+        st.added += n;
+        done.push_back(roots[i]);
+        log_line("[EXPAND] " + roots[i] + ": " + std::to_string(found[i].entries.size()) + " entries, " + std::to_string(n) + " new");
+    }
+    out.flush();
+    // entries first: a crash in between only means listing it again
+    if (!out) { log_line("[WARN] Failed to write list '" + name + "'", true); return st; }
+    if (!journal.record_done_all(done)) log_line("[WARN] Failed to journal expanded playlists", true);
+    st.collections = done.size();
+    return st;
+}
+
 static void download_and_cleanup(const std::string &listname, Config &cfg, ToolInstaller &ti) {
-    std::vector<std::string> urls = load_list(listname);
-    if (urls.empty()) { std::cout << "[!] List '" << listname << "' is empty\n"; return; }
+    auto &archive = DownloadArchive::instance();
+    // Every success is journaled at once, so a killed run resumes where it
+    // stopped; the list file itself is only rewritten by compaction.
+    ListJournal journal(listname);
+    // playlists and channels become one entry per video first, so the pool
+    // can run them in parallel and each is tracked on its own
+    if (file_exists(ti.yt_dlp_path())) expand_list(listname, journal, ti.yt_dlp_path(), cfg.jobs);
+    // Entries are leased a batch at a time, so other instances can drain the
+    // same list alongside this one. URLs already in the archive, or repeating
+    // an earlier entry, are done without a download; failed ones still
+    // backing off wait for a later run.
+    ListLeases leases(listname, journal);
+    const size_t claimSize = std::max<size_t>(16, 4 * (size_t)cfg.jobs * (size_t)cfg.batch);
+    std::unordered_set<uint64_t> seen, held;   // taken or known; backing off or failed in this run
+    size_t known = 0, waiting = 0;
+    int64_t soonest = 0;
+    auto admit = [&](const std::string &u) {
+        std::string key = canonical_key(u);
+        uint64_t h = hash64(key);
+        if (held.count(h)) return ListLeases::Claim::Skip;
+        if (seen.count(h) || archive.contains(key)) { known++; return ListLeases::Claim::Done; }
+        UrlRecord r = journal.state(u);
+        if (r.state == UrlState::Failed && r.nextRetry > (int64_t)std::time(nullptr)) {
+            held.insert(h);
+            waiting++;
+            soonest = soonest ? std::min(soonest, r.nextRetry) : r.nextRetry;
+            return ListLeases::Claim::Skip;
+        }
+        seen.insert(h);
+        return ListLeases::Claim::Take;
+    };
+    auto summary = [&] {
+        if (known) std::cout << "[SKIP] " << known << " URLs already downloaded or listed twice\n";
+        if (waiting) std::cout << "[WAIT] " << waiting << " URLs backing off after failures, next one eligible in "
+                               << format_duration(std::max<int64_t>(0, soonest - (int64_t)std::time(nullptr))) << "\n";
+        if (size_t n = leases.leased_elsewhere()) std::cout << "[LEASE] " << n << " URLs leased by other instances\n";
+    };
+    std::vector<std::string> first = leases.claim(claimSize, admit);
+    if (first.empty()) {
+        summary();
+        if (known) journal.compact();
+        else if (!waiting && !leases.leased_elsewhere()) std::cout << "[!] List '" << listname << "' is empty\n";
+        return;
+    }
     std::string ytdlp = ti.yt_dlp_path();
     if (!file_exists(ytdlp)) { std::cerr << "[ERR] yt-dlp missing, run Ensure tools first.\n"; return; }
     std::string ff = ti.ffmpeg_path();
     if (!file_exists(ff)) ff.clear();
 
-    std::cout << "[*] Starting downloads for list '" << listname << "': " << urls.size() << " URLs\n";
-    std::vector<std::string> remaining;
-    for (size_t i=0;i<urls.size();++i) {
-        std::string url = urls[i];
-        std::cout << "\n--- (" << (i+1) << "/" << urls.size() << ") " << url << " ---\n";
-        std::string cmd;
-        build_yt_dlp_cmd(cfg, ytdlp, ff, url, cmd);
-        std::cout << "[CMD] " << cmd << "\n";
-        int rc = exec_with_progress(cmd);
-        if (rc == 0) {
-            std::cout << "[OK] Download succeeded, removing from list\n";
-        } else {
-            std::cerr << "[FAIL] yt-dlp exit " << rc << " -> keeping URL for retry\n";
-            remaining.push_back(url);
+    std::cout << "[*] Starting downloads for list '" << listname << "': " << list_info(listname).pending() << " URLs pending";
+    if (cfg.jobs > 1) std::cout << " (" << (cfg.adaptive ? "adaptive, up to " : "") << cfg.jobs << " jobs, " << cfg.perHost << " per host)";
+    if (cfg.batch > 1) std::cout << " in batches of " << cfg.batch;
+    if (cfg.rateLimit) std::cout << ", limited to " << format_bps((double)cfg.rateLimit);
+    std::cout << "\n";
+
+    DownloadPool pool(cfg, ytdlp, ff);
+    RunMetrics metrics(cfg.prometheusFile);
+    MediaDedup dedup(cfg.dedup);
+    // tops the queue up as it drains; each claim starts from the top of the
+    // list, so entries whose leases ran out are picked up first
+    auto refill = [&] {
+        size_t queued = pool.stats().queued;
+        if (queued >= claimSize / 2) return;
+        std::vector<std::string> more = leases.claim(claimSize - queued, admit);
+        if (!more.empty()) pool.submit(listname, more);
+    };
+    pool.onSuccess = [&](const PoolEntry &e) {
+        archive.add(canonical_key(e.url));
+        if (!journal.record_done(e.url)) log_line("[WARN] Failed to journal " + e.url, true);
+        if (journal.pending() >= JOURNAL_COMPACT_EVERY && !journal.compact()) log_line("[WARN] List compaction failed", true);
+        MediaCatalog::instance().add(e);
+        dedup.add(e.file);
+    };
+    pool.onState = [&](const PoolEntry &e, UrlState st) { record_state(journal, e, st); };
+    pool.onFinish = [&](const PoolEntry &e) {
+        if (!e.ok) {
+            record_failure(journal, e);
+            held.insert(hash64(canonical_key(e.url)));
+        }
+        leases.release(e.url);
+        metrics.record(e);
+        refill();
+    };
+    pool.onTick = [&] {
+        metrics.export_prom(pool.stats());
+        leases.renew();
+    };
+    pool.run(listname, first);
+    metrics.export_prom(pool.stats(), true);
+    metrics.print_summary();
+    dedup.finish();
+    dedup.print_summary();
+    summary();
+    if (!journal.compact()) std::cerr << "[WARN] Failed to update list file\n";
+    else std::cout << "[INFO] List updated: " << list_info(listname).pending() << " URLs remain\n";
+}
+
+// ---------- Daemon + control socket ----------
+// "StreamHarvester daemon" keeps one DownloadPool alive and takes commands,
+// one per line, on a Unix domain socket; "StreamHarvester ctl <command>" is
+// the client. Every reply is zero or more lines followed by a line starting
+// with "OK" or "ERR".
+//   add <list> <url>     append to the list (deduplicated) and queue it; a
+//                        playlist or channel is expanded into its entries
+//   start <list>         queue every pending URL of a list
+//   status               counters plus one line per running job
+//   lists                list names with their URL counts
+//   pause | resume       stop / restart taking new jobs
+//   cancel [list]        drop queued URLs (of one list, or all)
+//   shutdown             finish running jobs and exit
+static const char CONTROL_SOCKET[] = "internals/control.sock";
+static volatile std::sig_atomic_t g_stop_requested = 0;
+
+#ifndef _WIN32
+static void on_stop_signal(int) { g_stop_requested = 1; }
+
+static bool control_address(sockaddr_un &addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (sizeof(CONTROL_SOCKET) > sizeof(addr.sun_path)) return false;
+    std::memcpy(addr.sun_path, CONTROL_SOCKET, sizeof(CONTROL_SOCKET));
+    return true;
+}
+
+class Daemon {
+public:
+    Daemon(Config &cfg, ToolInstaller &ti) : cfg_(cfg), ti_(ti) {}
+
+    int run() {
+        std::string ytdlp = ti_.yt_dlp_path(), ff = ti_.ffmpeg_path();
+        if (!file_exists(ytdlp)) { std::cerr << "[ERR] yt-dlp missing, run Ensure tools first.\n"; return 1; }
+        ytdlp_ = ytdlp;
+        if (!file_exists(ff)) ff.clear();
+
+        sockaddr_un addr;
+        if (!control_address(addr)) { std::cerr << "[ERR] socket path too long\n"; return 1; }
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (probe >= 0 && connect(probe, (sockaddr*)&addr, sizeof(addr)) == 0) {
+            close(probe);
+            std::cerr << "[ERR] a daemon is already listening on " << CONTROL_SOCKET << "\n";
+            return 1;
+        }
+        if (probe >= 0) close(probe);
+        unlink(CONTROL_SOCKET);   // stale socket from a crashed daemon
+        int lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (lfd < 0 || bind(lfd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(lfd, 16) != 0) {
+            std::cerr << "[ERR] cannot listen on " << CONTROL_SOCKET << ": " << std::strerror(errno) << "\n";
+            if (lfd >= 0) close(lfd);
+            return 1;
+        }
+        chmod(CONTROL_SOCKET, 0600);
+        std::signal(SIGINT, on_stop_signal);
+        std::signal(SIGTERM, on_stop_signal);
+        std::signal(SIGPIPE, SIG_IGN);
+
+        pool_.reset(new DownloadPool(cfg_, ytdlp, ff));
+        pool_->onSuccess = [this](const PoolEntry &e) {
+            DownloadArchive::instance().add(canonical_key(e.url));
+            ListJournal &j = journal(e.list);
+            if (!j.record_done(e.url)) log_line("[WARN] Failed to journal " + e.url, true);
+            if (j.pending() >= JOURNAL_COMPACT_EVERY) j.compact();
+            MediaCatalog::instance().add(e);
+            dedup_->add(e.file);
+        };
+        metrics_.reset(new RunMetrics(cfg_.prometheusFile));
+        dedup_.reset(new MediaDedup(cfg_.dedup));
+        pool_->onState = [this](const PoolEntry &e, UrlState st) { record_state(journal(e.list), e, st); };
+        pool_->onFinish = [this](const PoolEntry &e) {
+            metrics_->record(e);
+            // transient failures go back into the pool, held until their backoff ends
+            int64_t delay = e.ok ? 0 : record_failure(journal(e.list), e);
+            if (delay > 0 && !g_stop_requested) {
+                pool_->submit(e.list, {e.url}, std::chrono::steady_clock::now() + std::chrono::seconds(delay));
+                return;
+            }
+            finished(e);
+        };
+        pool_->onTick = [this] {
+            metrics_->export_prom(pool_->stats());
+            std::vector<ListLeases*> all;
+            { std::lock_guard<std::mutex> lk(jm_); for (auto &kv : leases_) all.push_back(kv.second.get()); }
+            for (auto *l : all) l->renew();
+        };
+        pool_->start(false);
+        expander_ = std::thread([this] { expand_loop(); });
+        std::cout << "[DAEMON] listening on " << CONTROL_SOCKET << " (" << cfg_.jobs << " jobs)\n";
+
+        while (!g_stop_requested) {
+            pollfd pfd{lfd, POLLIN, 0};
+            if (poll(&pfd, 1, 200) <= 0) continue;
+            int cfd = accept4(lfd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (cfd >= 0) { serve(cfd); close(cfd); }
+        }
+
+        std::cout << "[DAEMON] shutting down, waiting for running jobs...\n";
+        close(lfd);
+        unlink(CONTROL_SOCKET);
+        { std::lock_guard<std::mutex> lk(em_); expandStop_ = true; }
+        expandCv_.notify_all();
+        expander_.join();   // a listing in progress runs to its end
+        pool_->stop();
+        metrics_->export_prom(pool_->stats(), true);
+        dedup_->finish();
+        dedup_->print_summary();
+        std::lock_guard<std::mutex> lk(jm_);
+        for (auto &kv : leases_) kv.second->release_all();
+        for (auto &kv : journals_) kv.second->compact();
+        return 0;
+    }
+
+private:
+    // Reads command lines until EOF; a silent client is dropped after 2 s.
+    void serve(int cfd) {
+        std::string buf;
+        char chunk[1024];
+        while (true) {
+            size_t nl;
+            while ((nl = buf.find('\n')) != std::string::npos) {
+                std::string reply = handle(trim(buf.substr(0, nl)));
+                buf.erase(0, nl + 1);
+                if (send(cfd, reply.data(), reply.size(), 0) < 0) return;
+            }
+            pollfd pfd{cfd, POLLIN, 0};
+            if (poll(&pfd, 1, 2000) <= 0) return;
+            ssize_t n = recv(cfd, chunk, sizeof(chunk), 0);
+            if (n <= 0) { if (!trim(buf).empty()) { std::string r = handle(trim(buf)); send(cfd, r.data(), r.size(), 0); } return; }
+            buf.append(chunk, n);
+        }
+    }
+
+    std::string handle(const std::string &line) {
+        std::string cmd = line.substr(0, line.find(' '));
+        std::string arg = line.size() > cmd.size() ? trim(line.substr(cmd.size())) : "";
+        if (cmd.empty()) return "ERR empty command\n";
+        if (cmd == "add") {
+            size_t sp = arg.find(' ');
+            if (sp == std::string::npos) return "ERR usage: add <list> <url>\n";
+            std::string list = sanitize_name(arg.substr(0, sp)), url = trim(arg.substr(sp + 1));
+            // a playlist is expanded again each time, queueing its new entries
+            if (is_collection_url(url)) {
+                if (!append_to_list(list, url)) return "ERR cannot write list '" + list + "'\n";
+                std::string r = handle("start " + list);
+                return r.rfind("OK ", 0) == 0 ? "OK listing " + url + " in the background; " + r.substr(3) : r;
+            }
+            std::string key = canonical_key(url);
+            {
+                std::lock_guard<std::mutex> lk(m_);
+                if (!listed(list).insert(hash64(key)).second) return "OK skipped, already in '" + list + "'\n";
+            }
+            if (DownloadArchive::instance().contains(key)) return "OK skipped, already downloaded\n";
+            if (!append_to_list(list, url)) return "ERR cannot write list '" + list + "'\n";
+            if (!leases(list).take(url)) return "OK listed in '" + list + "', leased by another instance\n";
+            queue(list, {url});
+            return "OK queued in '" + list + "'\n";
+        }
+        if (cmd == "start") {
+            std::string list = sanitize_name(arg);
+            if (arg.empty() || !fs::exists(list_path(list))) return "ERR no such list '" + arg + "'\n";
+            // its playlists are listed on the expander thread, which queues
+            // their entries when done; the rest starts now
+            {
+                std::lock_guard<std::mutex> lk(em_);
+                if (std::find(expandQueue_.begin(), expandQueue_.end(), list) == expandQueue_.end()) {
+                    expandQueue_.push_back(list);
+                    std::lock_guard<std::mutex> ml(m_);
+                    ++expanding_[list];
+                }
+            }
+            expandCv_.notify_one();
+            { std::lock_guard<std::mutex> lk(m_); draining_.insert(list); }
+            size_t waiting = 0, queued = fill(list, &waiting);
+            size_t elsewhere = leases(list).leased_elsewhere(), pending = list_info(list).pending();
+            return "OK queued " + std::to_string(queued) + " of " + std::to_string(pending) + " URLs from '" + list + "'"
+                + (waiting ? " (+" + std::to_string(waiting) + " waiting for a retry)" : "")
+                + (elsewhere ? ", " + std::to_string(elsewhere) + " leased by other instances" : "") + "\n";
+        }
+        if (cmd == "status") {
+            auto st = pool_->stats();
+            std::string out = std::string(st.paused ? "paused" : "running") + " queued=" + std::to_string(st.queued)
+                + " active=" + std::to_string(st.active) + " done=" + std::to_string(st.done)
+                + " failed=" + std::to_string(st.failed) + " jobs=" + std::to_string(st.limit) + "/" + std::to_string(st.maxJobs)
+                + " rate=" + format_bps(st.rate) + " converting=" + std::to_string(st.converting) + dedup_->status() + "\n";
+            for (auto &j : pool_->active_jobs()) out += "job " + j + "\n";
+            return out + "OK\n";
+        }
+        if (cmd == "lists") {
+            std::string out;
+            auto names = list_names();
+            auto infos = list_infos(names);
+            for (size_t i = 0; i < names.size(); ++i) out += names[i] + " " + std::to_string(infos[i].pending()) + "\n";
+            return out + "OK\n";
+        }
+        if (cmd == "pause" || cmd == "resume") { pool_->set_paused(cmd == "pause"); return "OK " + cmd + "d\n"; }
+        if (cmd == "cancel") {
+            {
+                std::lock_guard<std::mutex> lk(m_);
+                if (arg.empty()) draining_.clear();
+                else draining_.erase(sanitize_name(arg));
+            }
+            auto dropped = pool_->cancel(arg.empty() ? "" : sanitize_name(arg));
+            for (auto &e : dropped) finished(e);
+            return "OK canceled " + std::to_string(dropped.size()) + " queued URLs\n";
+        }
+        if (cmd == "shutdown") { g_stop_requested = 1; return "OK shutting down\n"; }
+        return "ERR unknown command '" + cmd + "'\n";
+    }
+
+    void queue(const std::string &list, const std::vector<std::string> &urls,
+               std::chrono::steady_clock::time_point notBefore = {}) {
+        if (urls.empty()) return;
+        journal(list);
+        { std::lock_guard<std::mutex> lk(m_); outstanding_[list] += urls.size(); }
+        pool_->submit(list, urls, notBefore);
+    }
+
+    // Leases and queues up to claim_size() entries of a list being drained,
+    // minus those it already has in the pool; returns how many it queued
+    // (waiting: of those, how many are held until their backoff ends). The
+    // daemon's own leases cover entries it already queued.
+    size_t fill(const std::string &list, size_t *waiting = nullptr) {
+        std::lock_guard<std::mutex> fl(fill_);
+        size_t have;
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (!draining_.count(list)) return 0;
+            have = outstanding_[list];
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        size_t want = claim_size();
+        if (have >= want / 2) return 0;
+        auto &archive = DownloadArchive::instance();
+        ListJournal &j = journal(list);
+        std::unordered_set<uint64_t> seen;
+        std::vector<std::string> claimed = leases(list).claim(want - have, [&](const std::string &u) {
+            if (is_collection_url(u)) return ListLeases::Claim::Skip;   // the expander's
+            std::string key = canonical_key(u);
+            if (!seen.insert(hash64(key)).second || archive.contains(key)) return ListLeases::Claim::Done;
+            return pool_->is_queued(list, u) ? ListLeases::Claim::Skip : ListLeases::Claim::Take;
+        });
+        std::vector<std::string> todo;
+        int64_t now = (int64_t)std::time(nullptr);
+        for (auto &u : claimed) {
+            UrlRecord r = j.state(u);
+            // entries still backing off are queued too, but held until eligible
+            if (r.state == UrlState::Failed && r.nextRetry > now) {
+                queue(list, {u}, std::chrono::steady_clock::now() + std::chrono::seconds(r.nextRetry - now));
+                if (waiting) (*waiting)++;
+            } else todo.push_back(u);
+        }
+        queue(list, todo);
+        return claimed.size();
+    }
+
+    // Expander thread: runs expand_list() for lists given to "start", so the
+    // yt-dlp listing never holds up the accept loop, then queues the new
+    // entries of lists still being drained.
+    void expand_loop() {
+        std::unique_lock<std::mutex> lk(em_);
+        for (;;) {
+            expandCv_.wait(lk, [this] { return expandStop_ || !expandQueue_.empty(); });
+            if (expandStop_) return;
+            std::string list = std::move(expandQueue_.front());
+            expandQueue_.pop_front();
+            lk.unlock();
+            std::vector<std::string> added;
+            expand_list(list, journal(list), ytdlp_, cfg_.jobs, &added);
+            if (!added.empty()) {
+                std::lock_guard<std::mutex> ml(m_);
+                auto &set = listed(list);
+                for (auto &u : added) set.insert(hash64(canonical_key(u)));
+            }
+            if (!g_stop_requested) fill(list);
+            {
+                std::lock_guard<std::mutex> ml(m_);
+                if (--expanding_[list] == 0) {
+                    expanding_.erase(list);
+                    if (outstanding_[list] == 0) draining_.erase(list);
+                }
+            }
+            lk.lock();
+        }
+    }
+
+    // Entries one fill() leases, as download_and_cleanup claims them.
+    size_t claim_size() const { return std::max<size_t>(16, 4 * (size_t)cfg_.jobs * (size_t)cfg_.batch); }
+
+    // An entry left the pool: its lease goes, a list being drained is topped
+    // up, and the list's journal is folded in once none of its entries remain.
+    void finished(const PoolEntry &e) {
+        pool_->forget(e);
+        leases(e.list).release(e.url);
+        bool idle;
+        { std::lock_guard<std::mutex> lk(m_); idle = --outstanding_[e.list] == 0; }
+        if (!g_stop_requested) fill(e.list);
+        if (idle) {
+            std::lock_guard<std::mutex> lk(m_);
+            idle = outstanding_[e.list] == 0;
+            if (idle && !expanding_.count(e.list)) draining_.erase(e.list);
+        }
+        if (idle) journal(e.list).compact();
+    }
+
+    ListJournal &journal(const std::string &list) {
+        std::lock_guard<std::mutex> lk(jm_);
+        auto &j = journals_[list];
+        if (!j) j.reset(new ListJournal(list));
+        return *j;
+    }
+
+    ListLeases &leases(const std::string &list) {
+        ListJournal &j = journal(list);
+        std::lock_guard<std::mutex> lk(jm_);
+        auto &l = leases_[list];
+        if (!l) l.reset(new ListLeases(list, j));
+        return *l;
+    }
+
+    // Canonical-key hashes of a list's entries, loaded on first use; caller holds m_.
+    std::unordered_set<uint64_t> &listed(const std::string &list) {
+        auto it = listed_.find(list);
+        if (it != listed_.end()) return it->second;
+        auto &set = listed_[list];
+        ListCursor cur(list);
+        for (std::string u; cur.next(u);) set.insert(hash64(canonical_key(u)));
+        return set;
     }
-    if (!save_list(listname, remaining)) std::cerr << "[WARN] Failed to update list file\n";
-    else std::cout << "[INFO] List updated: " << remaining.size() << " URLs remain\n";
+
+    Config &cfg_;
+    ToolInstaller &ti_;
+    std::string ytdlp_;
+    std::unique_ptr<RunMetrics> metrics_;     // declared first: outlives the pool's callbacks
+    std::unique_ptr<MediaDedup> dedup_;       // likewise
+    std::unique_ptr<DownloadPool> pool_;
+    std::mutex m_, jm_;   // m_: listed_ + outstanding_, jm_: journals_ + leases_
+    std::map<std::string, std::unique_ptr<ListJournal>> journals_;
+    std::map<std::string, std::unique_ptr<ListLeases>> leases_;   // declared after journals_: released first
+    std::map<std::string, std::unordered_set<uint64_t>> listed_;
+    std::map<std::string, size_t> outstanding_;   // queued + running entries per list
+    std::set<std::string> draining_;               // lists "start" is working through, guarded by m_
+    std::map<std::string, int> expanding_;         // expand_list() runs queued or going per list, guarded by m_
+    std::mutex fill_;                              // one fill() at a time
+    std::mutex em_;                                // expandQueue_ + expandStop_
+    std::condition_variable expandCv_;
+    std::deque<std::string> expandQueue_;          // lists waiting for expand_list()
+    bool expandStop_ = false;
+    std::thread expander_;
+};
+
+// Sends one command to the daemon and prints the reply; exit code 1 on ERR.
+static int control_client(const std::vector<std::string> &args) {
+    std::string line;
+    for (size_t i=1;i<args.size();++i) line += (i>1 ? " " : "") + args[i];
+    if (line.empty()) { std::cerr << "usage: StreamHarvester ctl <add|start|status|lists|pause|resume|cancel|shutdown> [args]\n"; return 2; }
+    sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || !control_address(addr) || connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        std::cerr << "[ERR] no daemon listening on " << CONTROL_SOCKET << "\n";
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+    line += "\n";
+    send(fd, line.data(), line.size(), 0);
+    shutdown(fd, SHUT_WR);
+    std::string reply;
+    char buf[4096];
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) reply.append(buf, n);
+    close(fd);
+    std::cout << reply;
+    size_t last = reply.rfind('\n', reply.size() >= 2 ? reply.size() - 2 : 0);
+    std::string tail = reply.substr(last == std::string::npos ? 0 : last + 1);
+    return tail.rfind("OK",0)==0 ? 0 : 1;
+}
+#else
+class Daemon {
+public:
+    Daemon(Config &, ToolInstaller &) {}
+    int run() { std::cerr << "[ERR] daemon mode needs Unix domain sockets, not available on this platform\n"; return 1; }
+};
+static int control_client(const std::vector<std::string> &) {
+    std::cerr << "[ERR] daemon mode needs Unix domain sockets, not available on this platform\n";
+    return 1;
 }
+#endif
 
 // ---------- Menus (numeric) ----------
 // Modified: do NOT clear the screen every time; show compact header.
@@ -391,7 +4833,7 @@ static void show_main_menu() {
     std::cout << "1) Manage lists (create / choose / delete)\n";
     std::cout << "2) Add URL to a list\n";
     std::cout << "3) Show lists and counts\n";
-    std::cout << "4) Settings (mode / quality / format)\n";
+    std::cout << "4) Settings (mode / quality / format / parallel jobs)\n";
     std::cout << "5) Ensure tools (yt-dlp / ffmpeg)\n";
     std::cout << "6) Start downloads for a list\n";
     std::cout << "r) Refresh screen (clear & redraw banner)\n";
@@ -404,10 +4846,11 @@ static void show_main_menu() {
 static void manage_lists_menu() {
     while (true) {
         auto names = list_names();
+        auto infos = list_infos(names);
         std::cout << "\n--- Lists Manager ---\n";
         std::cout << "Existing lists:\n";
-        for (size_t i=0;i<names.size();++i) std::cout << "  " << (i+1) << ") " << names[i] << " (" << load_list(names[i]).size() << " urls)\n";
-        std::cout << "\nOptions:\n  n) Create new list\n  d) Delete a list\n  b) Back\nChoice: ";
+        for (size_t i=0;i<names.size();++i) std::cout << "  " << (i+1) << ") " << names[i] << " (" << infos[i].pending() << " urls)\n";
+        std::cout << "\nOptions:\n  n) Create new list\n  i) Import URLs from a file\n  p) Download profile of a list\n  d) Delete a list\n  b) Back\nChoice: ";
         std::string choice; std::getline(std::cin, choice);
         if (choice=="b"||choice=="B") break;
         if (choice=="n"||choice=="N") {
@@ -419,6 +4862,51 @@ static void manage_lists_menu() {
             save_list(sanitized, {}); std::cout << "[OK] Created list '" << sanitized << "'\n";
             continue;
         }
+        if (choice=="i"||choice=="I") {
+            std::cout << "Enter number of list to import into: ";
+            std::string num; std::getline(std::cin, num);
+            int idx=0; try{ idx = std::stoi(num);}catch(...){ std::cout<<"Invalid\n"; continue; }
+            auto names2 = list_names();
+            if (idx<1||idx>(int)names2.size()){ std::cout<<"Invalid\n"; continue; }
+            std::cout << "Path of file with one URL per line: ";
+            std::string file; std::getline(std::cin, file); file = trim(file);
+            ImportStats st;
+            if (!import_urls(names2[idx-1], file, st)) { std::cout << "[ERR] Cannot read '" << file << "'\n"; continue; }
+            std::cout << "[OK] Imported " << st.added << " URLs into '" << names2[idx-1] << "' (skipped: "
+                      << st.listed << " already listed, " << st.archived << " already downloaded, " << st.repeated << " repeated)\n";
+            continue;
+        }
+        if (choice=="p"||choice=="P") {
+            std::cout << "Enter number of list: ";
+            std::string num; std::getline(std::cin, num);
+            int idx=0; try{ idx = std::stoi(num);}catch(...){ std::cout<<"Invalid\n"; continue; }
+            auto names2 = list_names();
+            if (idx<1||idx>(int)names2.size()){ std::cout<<"Invalid\n"; continue; }
+            DownloadProfile p = load_profile(names2[idx-1]);
+            std::cout << "Fragments fetched in parallel for HLS/DASH (1-64, a = auto). Current: "
+                      << (p.autoFragments ? "auto" : std::to_string(std::max(1, p.fragments))) << "\nChoice: ";
+            std::string v; std::getline(std::cin, v); v = trim(v);
+            if (v == "a" || v == "auto") { p.autoFragments = true; p.fragments = 0; }
+            else if (!v.empty()) { p.autoFragments = false; p.fragments = parse_int_clamped(v, p.fragments, 1, 64); }
+            std::cout << "HTTP chunk size, e.g. 10M (0 = off). Current: " << format_rate(p.chunkSize) << "\nChoice: ";
+            std::getline(std::cin, v); v = trim(v);
+            if (!v.empty()) p.chunkSize = parse_rate(v, p.chunkSize);
+            std::cout << "Download buffer size, e.g. 1M (0 = default). Current: " << format_rate(p.bufferSize) << "\nChoice: ";
+            std::getline(std::cin, v); v = trim(v);
+            if (!v.empty()) p.bufferSize = parse_rate(v, p.bufferSize);
+            std::cout << "External downloader, e.g. aria2c (- = none). Current: " << (p.downloader.empty() ? "none" : p.downloader) << "\nChoice: ";
+            std::getline(std::cin, v); v = trim(v);
+            if (v == "-") { p.downloader.clear(); p.downloaderArgs.clear(); }
+            else if (!v.empty()) p.downloader = v;
+            if (!p.downloader.empty()) {
+                std::cout << "Its arguments, e.g. aria2c:-x 8 -s 8 (- = none). Current: " << p.downloaderArgs << "\nChoice: ";
+                std::getline(std::cin, v); v = trim(v);
+                if (v == "-") p.downloaderArgs.clear(); else if (!v.empty()) p.downloaderArgs = v;
+            }
+            if (save_profile(names2[idx-1], p)) std::cout << "[OK] Saved " << profile_path(names2[idx-1]) << "\n";
+            else std::cout << "[ERR] Cannot write " << profile_path(names2[idx-1]) << "\n";
+            continue;
+        }
         if (choice=="d"||choice=="D") {
             std::cout << "Enter number of list to delete: ";
             std::string num; std::getline(std::cin, num);
@@ -435,9 +4923,10 @@ static void manage_lists_menu() {
             int idx = std::stoi(choice);
             auto names2 = list_names();
             if (idx>=1 && idx <= (int)names2.size()) {
-                auto urls = load_list(names2[idx-1]);
-                std::cout << "\nList '" << names2[idx-1] << "' (" << urls.size() << "):\n";
-                for (size_t i=0;i<urls.size();++i) std::cout << "  " << i << ": " << urls[i] << "\n";
+                std::cout << "\nList '" << names2[idx-1] << "' (" << list_info(names2[idx-1]).pending() << "):\n";
+                ListCursor cur(names2[idx-1]);
+                size_t i = 0;
+                for (std::string u; cur.next(u); ++i) std::cout << "  " << i << ": " << u << "\n";
                 std::cout << "Press Enter..."; std::string tmp; std::getline(std::cin, tmp);
             } else std::cout<<"Invalid selection\n";
         } catch(...) { std::cout << "Unknown option\n"; }
@@ -470,6 +4959,9 @@ static void add_url_flow() {
 
     std::cout << "\nAdding URLs to list '" << targetList << "'.\n";
     std::cout << "Enter one URL per line. Press Enter on an empty line to finish and return to the menu.\n\n";
+    std::unordered_set<uint64_t> listed;
+    ListCursor cur(targetList);
+    for (std::string u; cur.next(u);) listed.insert(hash64(canonical_key(u)));
 
     while (true) {
         std::cout << "URL: ";
@@ -479,6 +4971,9 @@ static void add_url_flow() {
             std::cout << "[OK] Finished adding URLs to '" << targetList << "'.\n";
             break;
         }
+        std::string key = canonical_key(url);
+        if (!listed.insert(hash64(key)).second) { std::cout << "[SKIP] already in '" << targetList << "': " << url << "\n"; continue; }
+        if (DownloadArchive::instance().contains(key)) { std::cout << "[SKIP] already downloaded: " << url << "\n"; continue; }
         if (append_to_list(targetList, url)) {
             std::cout << "[ADDED] " << url << "\n";
         } else {
@@ -490,12 +4985,35 @@ static void add_url_flow() {
 static void show_lists_and_counts() {
     auto names = list_names();
     if (names.empty()) { std::cout << "(no lists)\n"; return; }
+    auto infos = list_infos(names);
     std::cout << "\nLists:\n";
-    for (size_t i=0;i<names.size();++i) std::cout << " " << (i+1) << ") " << names[i] << " - " << load_list(names[i]).size() << " URLs\n";
+    for (size_t i=0;i<names.size();++i) {
+        std::cout << " " << (i+1) << ") " << names[i] << " - " << infos[i].pending() << " URLs";
+        if (infos[i].done) std::cout << " (" << infos[i].done << " done, not yet compacted)";
+        std::cout << "\n";
+    }
 }
 
 // ---------- Main ----------
-int main() {
+// The benchmarks in bench/ include this file with STREAMHARVESTER_NO_MAIN defined.
+#ifndef STREAMHARVESTER_NO_MAIN
+int main(int argc, char **argv) {
+    // flags first, then an optional subcommand
+    bool fast = false;
+    std::vector<std::string> args;
+    for (int i=1;i<argc;++i) { std::string a = argv[i]; if (a == "--fast") fast = true; else args.push_back(a); }
+    if (!args.empty() && args[0] == "ctl") return control_client(args);
+    if (args.size() >= 2 && args[0] == "find") {
+        std::string q = args[1];
+        for (size_t i = 2; i < args.size(); ++i) q += " " + args[i];
+        return catalog_find(q);
+    }
+    bool runList = !args.empty() && args[0] == "run" && args.size() == 2;
+    if (!args.empty() && args[0] != "daemon" && !runList) {
+        std::cerr << "usage: StreamHarvester [--fast] [run <list> | daemon | ctl <command> [args] | find <id|url|title>]\n";
+        return 2;
+    }
+
     enable_virtual_terminal();          // try to activate ANSI on windows
     ensure_dir("internals");
     ensure_dir("internals/lists");
@@ -505,13 +5023,29 @@ int main() {
     Config cfg = load_config(cfgfile);
     ToolInstaller ti;
 
-    // startup animation (only once)
-    animate_banner_startup();
+    // Non-interactive modes and --fast never animate; an unchanged tool
+    // manifest means no download, chmod or version subprocess at all.
+    bool interactive = args.empty();
+    if (interactive && !fast) animate_banner_startup();
+    if (ti.manifest_fresh()) {
+        if (interactive) std::cout << "[STARTUP] Tools unchanged since last check (" << ToolInstaller::manifest_path() << ")\n";
+    } else if (fast) {
+        std::cout << "[STARTUP] Tools changed or never checked; use 'Ensure tools' to verify them\n";
+    } else {
+        std::cout << "[STARTUP] Ensuring core tools (yt-dlp + ffmpeg) are present...\n";
+        bool y_ok = ti.ensure_yt_dlp();
+        bool f_ok = ti.ensure_ffmpeg();
+        ti.refresh_manifest();
+        std::cout << "[STARTUP] yt-dlp: " << (y_ok ? "ok" : "missing") << " ; ffmpeg: " << (f_ok ? "ok" : "missing") << "\n";
+    }
 
-    std::cout << "[STARTUP] Ensuring core tools (yt-dlp + ffmpeg) are present...\n";
-    bool y_ok = ti.ensure_yt_dlp();
-    bool f_ok = ti.ensure_ffmpeg();
-    std::cout << "[STARTUP] yt-dlp: " << (y_ok ? "ok" : "missing") << " ; ffmpeg: " << (f_ok ? "ok" : "missing") << "\n";
+    if (runList) {
+        std::string listname = sanitize_name(args[1]);
+        if (!fs::exists(list_path(listname))) { std::cerr << "[ERR] No list named '" << listname << "'\n"; return 1; }
+        download_and_cleanup(listname, cfg, ti);
+        return 0;
+    }
+    if (!args.empty()) return Daemon(cfg, ti).run();
 
     while (true) {
         show_main_menu();
@@ -559,6 +5093,32 @@ int main() {
                 else if (f=="2") cfg.targetFormat="mp4";
                 else if (f=="3") cfg.targetFormat="mp3";
             }
+            std::cout << "Parallel downloads (1-64). Current: " << cfg.jobs << "\nChoice: ";
+            std::string j; std::getline(std::cin,j); j = trim(j);
+            if (!j.empty()) cfg.jobs = parse_int_clamped(j, cfg.jobs, 1, 64);
+            std::cout << "Max parallel downloads per host (1-64). Current: " << cfg.perHost << "\nChoice: ";
+            std::string h; std::getline(std::cin,h); h = trim(h);
+            if (!h.empty()) cfg.perHost = parse_int_clamped(h, cfg.perHost, 1, 64);
+            std::cout << "URLs per yt-dlp process (1 = one process per URL). Current: " << cfg.batch << "\nChoice: ";
+            std::string bs; std::getline(std::cin,bs); bs = trim(bs);
+            if (!bs.empty()) cfg.batch = parse_int_clamped(bs, cfg.batch, 1, 1000);
+            std::cout << "Adapt parallel downloads to the link, up to the number above (y/n). Current: " << (cfg.adaptive ? "y" : "n") << "\nChoice: ";
+            std::string ad; std::getline(std::cin,ad); ad = trim(ad);
+            if (!ad.empty()) cfg.adaptive = (ad == "y" || ad == "Y");
+            std::cout << "Total bandwidth limit, e.g. 500K or 10M (0 = unlimited). Current: " << format_rate(cfg.rateLimit) << "\nChoice: ";
+            std::string rl; std::getline(std::cin,rl); rl = trim(rl);
+            if (!rl.empty()) cfg.rateLimit = parse_rate(rl, cfg.rateLimit);
+            std::cout << "Resolve metadata ahead of the downloads (y/n). Current: " << (cfg.prefetch ? "y" : "n") << "\nChoice: ";
+            std::string pf; std::getline(std::cin,pf); pf = trim(pf);
+            if (!pf.empty()) cfg.prefetch = (pf == "y" || pf == "Y");
+            if (cfg.prefetch) {
+                std::cout << "Download order (1 as listed, 2 smallest first, 3 largest first). Current: " << cfg.order << "\nChoice: ";
+                std::string od; std::getline(std::cin,od); od = trim(od);
+                if (od == "1") cfg.order = "fifo"; else if (od == "2") cfg.order = "sjf"; else if (od == "3") cfg.order = "ljf";
+            }
+            std::cout << "Hardlink identical downloaded files to one copy (y/n). Current: " << (cfg.dedup ? "y" : "n") << "\nChoice: ";
+            std::string dd; std::getline(std::cin,dd); dd = trim(dd);
+            if (!dd.empty()) cfg.dedup = (dd == "y" || dd == "Y");
             save_config(cfgfile, cfg);
             std::cout << "[OK] Settings saved\n";
             continue;
@@ -570,6 +5130,7 @@ int main() {
             print_banner(true);
             std::cout << "[*] Ensuring yt-dlp... "; bool y = ti.ensure_yt_dlp(); std::cout << (y?"OK":"FAILED") << "\n";
             std::cout << "[*] Ensuring ffmpeg... "; bool ff = ti.ensure_ffmpeg(); std::cout << (ff?"OK":"(not installed)") << "\n";
+            ti.refresh_manifest();
             if (!ff) std::cout << "[WARN] ffmpeg not available: conversions requiring ffmpeg may fail\n";
             std::cout << "\nPress Enter to return to menu..."; std::string _tmp2; std::getline(std::cin, _tmp2);
             continue;
@@ -578,8 +5139,9 @@ int main() {
         if (choice == "6") {
             auto names = list_names();
             if (names.empty()) { std::cout << "[!] No lists available.\n"; continue; }
+            auto infos = list_infos(names);
             std::cout << "Select list to download:\n";
-            for (size_t i=0;i<names.size();++i) std::cout << "  " << (i+1) << ") " << names[i] << " (" << load_list(names[i]).size() << " urls)\n";
+            for (size_t i=0;i<names.size();++i) std::cout << "  " << (i+1) << ") " << names[i] << " (" << infos[i].pending() << " urls)\n";
             std::cout << "Choice number: ";
             std::string c; std::getline(std::cin,c);
             int idx = -1; try { idx = std::stoi(trim(c)); } catch(...) { idx = -1; }
@@ -594,3 +5156,4 @@ int main() {
     std::cout << "Goodbye\n";
     return 0;
 }
+#endif // STREAMHARVESTER_NO_MAIN
@@ -0,0 +1,84 @@
+// Fixed vs. adaptive concurrency against a simulated shared link: fake_yt_dlp
+// splits FAKE_YTDLP_LINK_BPS between the running stubs, caps each connection
+// and answers HTTP 429 above a connection limit.
+//   g++ -std=c++17 -O2 bench/fake_yt_dlp.cpp -o fake_yt_dlp
+//   g++ -std=c++17 -O2 -pthread bench/bench_adaptive.cpp -o bench_adaptive
+//   ./bench_adaptive ./fake_yt_dlp [urls] [--json]
+// Defaults: 32 MiB/s link, 4 MiB/s per connection, 429 above 10 connections,
+// 4 MiB items, so 8 jobs fill the link.
+
+#define STREAMHARVESTER_NO_MAIN
+#include "../StreamHarvester.cpp"
+#include "bench_json.h"
+
+struct RunResult { double seconds = 0; size_t done = 0, failed = 0; int limit = 0; };
+
+static RunResult run_pool(const std::string &stub, int n, int jobs, bool adaptive, uint64_t budget) {
+    std::vector<std::string> urls;
+    for (int i = 0; i < n; ++i) urls.push_back("https://example.com/watch?v=item" + std::to_string(i));
+    Config cfg;
+    cfg.jobs = jobs;
+    cfg.perHost = 64;
+    cfg.adaptive = adaptive;
+    cfg.rateLimit = budget;
+
+    std::ofstream devnull;
+    auto *oldOut = std::cout.rdbuf(devnull.rdbuf());
+    auto *oldErr = std::cerr.rdbuf(devnull.rdbuf());
+    RunResult res;
+    auto t0 = std::chrono::steady_clock::now();
+    {
+        DownloadPool pool(cfg, stub, "");
+        pool.run("bench", urls);
+        auto st = pool.stats();
+        res.done = st.done; res.failed = st.failed; res.limit = st.limit;
+    }
+    res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cout.rdbuf(oldOut);
+    std::cerr.rdbuf(oldErr);
+    return res;
+}
+
+static void add(BenchReport &report, const std::string &key, const std::string &label, const RunResult &r, uint64_t itemBytes) {
+    report.result(key + "_s", r.seconds, label + ", wall time", "s");
+    report.result(key + "_mib_per_s", r.done * itemBytes / 1048576.0 / r.seconds, label + ", goodput", "MiB/s");
+    report.result(key + "_failed", (double)r.failed, label + ", failed", "URLs");
+    report.result(key + "_final_jobs", r.limit, label + ", final jobs", "");
+}
+
+int main(int argc, char **argv) {
+    BenchReport report("adaptive", argc, argv);
+    if (argc < 2) { std::fprintf(stderr, "usage: %s <fake_yt_dlp> [urls] [--json]\n", argv[0]); return 2; }
+    std::string stub = fs::absolute(argv[1]).string();
+    int n = argc > 2 ? std::atoi(argv[2]) : 120;
+
+    fs::path work = fs::temp_directory_path() / ("sh_bench_adaptive_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    fs::create_directories(work);
+    fs::current_path(work);
+    const uint64_t item = 4ull << 20;
+    auto set = [](const char *k, const std::string &v) {
+#ifdef _WIN32
+        _putenv_s(k, v.c_str());
+#else
+        setenv(k, v.c_str(), 1);
+#endif
+    };
+    set("FAKE_YTDLP_LINK_BPS", std::to_string(32ull << 20));
+    set("FAKE_YTDLP_CONN_BPS", std::to_string(4ull << 20));
+    set("FAKE_YTDLP_MAX_CONN", "10");
+    set("FAKE_YTDLP_SIZE", std::to_string(item));
+    set("FAKE_YTDLP_STARTUP_MS", "200");
+    set("FAKE_YTDLP_LINK_DIR", (work / "link").string());
+
+    report.param("urls", n);
+    report.param("link", "32 MiB/s, 4 MiB/s per connection, 429 above 10, 4 MiB items");
+    add(report, "fixed8", "fixed 8 jobs (ideal)", run_pool(stub, n, 8, false, 0), item);
+    add(report, "fixed16", "fixed 16 jobs", run_pool(stub, n, 16, false, 0), item);
+    add(report, "adaptive16", "adaptive up to 16", run_pool(stub, n, 16, true, 0), item);
+    add(report, "budget16m", "adaptive, 16 MiB/s budget", run_pool(stub, n, 16, true, 16ull << 20), item);
+    report.print();
+
+    fs::current_path(fs::temp_directory_path());
+    fs::remove_all(work);
+    return 0;
+}
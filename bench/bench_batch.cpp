@@ -0,0 +1,72 @@
+// Per-URL overhead of one yt-dlp process per URL vs. --batch-file batches,
+// measured end to end through download_and_cleanup against fake_yt_dlp.
+//   g++ -std=c++17 -O2 bench/fake_yt_dlp.cpp -o fake_yt_dlp
+//   g++ -std=c++17 -O2 -pthread bench/bench_batch.cpp -o bench_batch
+//   ./bench_batch ./fake_yt_dlp [urls] [batch] [--json]
+
+#define STREAMHARVESTER_NO_MAIN
+#include "../StreamHarvester.cpp"
+#include "bench_json.h"
+
+static size_t count_files(const char *dir) {
+    size_t n = 0;
+    std::error_code ec;
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) n += it->is_regular_file(ec);
+    return n;
+}
+
+// Runs one list of n URLs in a scratch directory; returns seconds, or -1 when
+// the run did not download all of them. Each run gets its own URLs: the
+// download archive of the process remembers the ones before.
+static double run_once(const std::string &stub, int n, int batch) {
+    std::vector<std::string> urls;
+    for (int i = 0; i < n; ++i) urls.push_back("https://example.com/watch?v=b" + std::to_string(batch) + "item" + std::to_string(i));
+    save_list("bench", urls);
+    try { fs::remove(journal_path("bench")); } catch(...) {}
+
+    Config cfg;
+    cfg.batch = batch;
+    ToolInstaller ti;
+    fs::copy_file(stub, ti.yt_dlp_path(), fs::copy_options::overwrite_existing);
+
+    std::ofstream devnull;
+    auto *oldOut = std::cout.rdbuf(devnull.rdbuf());
+    auto *oldErr = std::cerr.rdbuf(devnull.rdbuf());
+    size_t before = count_files("downloads");
+    auto t0 = std::chrono::steady_clock::now();
+    download_and_cleanup("bench", cfg, ti);
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cout.rdbuf(oldOut);
+    std::cerr.rdbuf(oldErr);
+    size_t got = count_files("downloads") - before, left = load_list("bench").size();
+    if (got != (size_t)n || left) {
+        std::fprintf(stderr, "batch=%d: downloaded %zu of %d URLs, %zu left over\n", batch, got, n, left);
+        return -1;
+    }
+    return s;
+}
+
+int main(int argc, char **argv) {
+    BenchReport report("batch", argc, argv);
+    if (argc < 2) { std::fprintf(stderr, "usage: %s <fake_yt_dlp> [urls] [batch] [--json]\n", argv[0]); return 2; }
+    std::string stub = fs::absolute(argv[1]).string();
+    int n = argc > 2 ? std::atoi(argv[2]) : 40;
+    int batch = argc > 3 ? std::atoi(argv[3]) : 20;
+
+    fs::path work = fs::temp_directory_path() / ("sh_bench_batch_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    fs::create_directories(work);
+    fs::current_path(work);
+
+    double single = run_once(stub, n, 1);
+    double batched = run_once(stub, n, batch);
+    fs::current_path(fs::temp_directory_path());
+    fs::remove_all(work);
+    if (single < 0 || batched < 0) return 1;
+    report.param("urls", n);
+    report.param("batch", batch);
+    report.result("single_ms_per_url", single * 1000 / n, "one process per URL", "ms/URL");
+    report.result("batch_ms_per_url", batched * 1000 / n, "batched", "ms/URL");
+    report.result("saved_ms_per_url", (single - batched) * 1000 / n, "overhead saved", "ms/URL");
+    report.print();
+    return 0;
+}
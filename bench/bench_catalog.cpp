@@ -0,0 +1,64 @@
+// Media catalog lookups at scale: appends N entries through MediaCatalog,
+// then times "find" by id, URL and title prefix, first with the index being
+// built, then against the saved index, then with unindexed lines behind it.
+//   g++ -std=c++17 -O2 -pthread bench/bench_catalog.cpp -o bench_catalog
+//   ./bench_catalog [entries] [--json]
+
+#define STREAMHARVESTER_NO_MAIN
+#include "../StreamHarvester.cpp"
+#include "bench_json.h"
+
+template <class F>
+static double time_ms(F fn) {
+    auto t0 = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// Eleven base64url digits of i, like a YouTube id.
+static std::string video_id(size_t i) {
+    char id[12];
+    for (int k = 10; k >= 0; --k, i /= 64) id[k] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-_"[i % 64];
+    id[11] = 0;
+    return id;
+}
+
+static PoolEntry entry(size_t i) {
+    PoolEntry e;
+    e.id = video_id(i);
+    e.url = "https://www.youtube.com/watch?v=" + e.id;
+    e.title = "Episode " + std::to_string(i) + " of the series";
+    e.file = "downloads/" + e.title + ".mp4";
+    e.vcodec = "avc1.64001F"; e.acodec = "mp4a.40.2";
+    e.duration = (double)(i % 7200);
+    return e;
+}
+
+int main(int argc, char **argv) {
+    BenchReport report("catalog", argc, argv);
+    size_t n = argc > 1 ? std::stoul(argv[1]) : 300000;
+
+    fs::path work = fs::temp_directory_path() / ("sh_bench_catalog_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    fs::create_directories(work / "internals");
+    fs::current_path(work);
+    report.param("entries", (double)n);
+
+    report.result("append_ms", time_ms([&] { for (size_t i = 0; i < n; ++i) MediaCatalog::instance().add(entry(i)); }), "append", "ms");
+
+    size_t hits = 0;
+    PoolEntry probe = entry(n / 2);
+    report.result("build_ms", time_ms([&] { hits += CatalogReader().by_id(probe.id).size(); }), "first query (index build)", "ms");
+    report.result("id_ms", time_ms([&] { hits += CatalogReader().by_id(probe.id).size(); }), "by id", "ms");
+    report.result("url_ms", time_ms([&] { hits += CatalogReader().by_key(canonical_key("https://youtu.be/" + probe.id)).size(); }), "by URL", "ms");
+    report.result("title_ms", time_ms([&] { hits += CatalogReader().by_title("episode " + std::to_string(n / 3), 50).size(); }), "by title prefix (50 max)", "ms");
+
+    for (size_t i = n; i < n + CATALOG_REINDEX / 2; ++i) MediaCatalog::instance().add(entry(i));
+    PoolEntry late = entry(n + 1);
+    report.result("tail_ms", time_ms([&] { hits += CatalogReader().by_id(late.id).size(); }), "by id, unindexed tail", "ms");
+    if (hits < 5) std::fprintf(stderr, "warning: only %zu hits\n", hits);
+    report.print();
+
+    fs::current_path(fs::temp_directory_path());
+    fs::remove_all(work);
+    return 0;
+}
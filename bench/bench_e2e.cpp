@@ -0,0 +1,81 @@
+// End-to-end throughput: N synthetic URLs through download_and_cleanup (archive
+// and dedup, pool, journal, compaction, metrics) against fake_yt_dlp, with
+// latency percentiles taken from the internals/metrics.jsonl the run wrote.
+//   g++ -std=c++17 -O2 bench/fake_yt_dlp.cpp -o fake_yt_dlp
+//   g++ -std=c++17 -O2 -pthread bench/bench_e2e.cpp -o bench_e2e
+//   ./bench_e2e ./fake_yt_dlp [urls] [jobs] [batch] [fail_rate] [--json]
+
+#define STREAMHARVESTER_NO_MAIN
+#include "../StreamHarvester.cpp"
+#include "bench_json.h"
+
+static double json_number(const std::string &line, const char *key) {
+    size_t p = line.find(std::string("\"") + key + "\":");
+    return p == std::string::npos ? 0 : std::atof(line.c_str() + p + std::strlen(key) + 3);
+}
+
+int main(int argc, char **argv) {
+    BenchReport report("e2e", argc, argv);
+    if (argc < 2) { std::fprintf(stderr, "usage: %s <fake_yt_dlp> [urls] [jobs] [batch] [fail_rate] [--json]\n", argv[0]); return 2; }
+    std::string stub = fs::absolute(argv[1]).string();
+    int n = argc > 2 ? std::atoi(argv[2]) : 200;
+    Config cfg;
+    cfg.jobs = argc > 3 ? std::atoi(argv[3]) : 8;
+    cfg.perHost = cfg.jobs;
+    cfg.batch = argc > 4 ? std::atoi(argv[4]) : 1;
+    std::string failRate = argc > 5 ? argv[5] : "0.05";
+
+    fs::path work = fs::temp_directory_path() / ("sh_bench_e2e_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    fs::create_directories(work);
+    fs::current_path(work);
+#ifdef _WIN32
+    _putenv_s("FAKE_YTDLP_STARTUP_MS", "50"); _putenv_s("FAKE_YTDLP_ITEM_MS", "100"); _putenv_s("FAKE_YTDLP_FAIL_RATE", failRate.c_str());
+#else
+    setenv("FAKE_YTDLP_STARTUP_MS", "50", 1); setenv("FAKE_YTDLP_ITEM_MS", "100", 1); setenv("FAKE_YTDLP_FAIL_RATE", failRate.c_str(), 1);
+#endif
+    report.param("urls", n);
+    report.param("jobs", cfg.jobs);
+    report.param("batch", cfg.batch);
+    report.param("fail_rate", std::atof(failRate.c_str()));
+
+    std::vector<std::string> urls;
+    for (int i = 0; i < n; ++i) urls.push_back("https://host" + std::to_string(i % 4) + ".example.com/watch?v=item" + std::to_string(i));
+    save_list("bench", urls);
+    ToolInstaller ti;
+    fs::copy_file(stub, ti.yt_dlp_path(), fs::copy_options::overwrite_existing);
+
+    std::ofstream devnull;
+    auto *oldOut = std::cout.rdbuf(devnull.rdbuf());
+    auto *oldErr = std::cerr.rdbuf(devnull.rdbuf());
+    auto t0 = std::chrono::steady_clock::now();
+    download_and_cleanup("bench", cfg, ti);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cout.rdbuf(oldOut);
+    std::cerr.rdbuf(oldErr);
+
+    std::vector<double> latency;
+    double bytes = 0;
+    size_t ok = 0;
+    std::ifstream metrics(METRICS_LOG);
+    for (std::string line; std::getline(metrics, line);) {
+        latency.push_back(json_number(line, "total_s"));
+        bytes += json_number(line, "bytes");
+        ok += line.find("\"ok\":true") != std::string::npos;
+    }
+    std::sort(latency.begin(), latency.end());
+    auto pct = [&](double q) { return latency.empty() ? 0 : latency[(size_t)std::max(0.0, std::ceil(q * latency.size()) - 1)]; };
+
+    report.result("wall_s", secs, "wall time", "s");
+    report.result("urls_per_s", n / secs, "throughput", "URLs/s");
+    report.result("mib_per_s", bytes / 1048576.0 / secs, "data rate (simulated)", "MiB/s");
+    report.result("ok", (double)ok, "succeeded", "URLs");
+    report.result("failed", (double)(latency.size() - ok), "failed", "URLs");
+    report.result("latency_p50_s", pct(0.5), "latency p50", "s");
+    report.result("latency_p95_s", pct(0.95), "latency p95", "s");
+    report.result("remaining", (double)load_list("bench").size(), "left in list", "URLs");
+    report.print();
+
+    fs::current_path(fs::temp_directory_path());
+    fs::remove_all(work);
+    return 0;
+}
@@ -0,0 +1,74 @@
+// Shared by the programs in bench/: collects a run's parameters and results
+// and prints them as aligned text or, with --json anywhere on the command
+// line, as one JSON object so runs can be stored and compared over time:
+//   {"bench":"lists","time":"2026-01-02T03:04:05Z","params":{"urls":1000000},
+//    "results":{"save_ms":412.3,"load_ms":230.1}}
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <utility>
+#include <vector>
+
+class BenchReport {
+public:
+    // Strips --json from argv so positional arguments keep their indexes.
+    BenchReport(const char *name, int &argc, char **argv) : name_(name) {
+        int out = 1;
+        for (int i = 1; i < argc; ++i) {
+            if (std::strcmp(argv[i], "--json") == 0) json_ = true;
+            else argv[out++] = argv[i];
+        }
+        argc = out;
+    }
+
+    bool json() const { return json_; }
+
+    void param(const std::string &key, double v) { params_.push_back({key, number(v)}); }
+    void param(const std::string &key, const std::string &v) { params_.push_back({key, "\"" + v + "\""}); }
+
+    // key is the JSON name; label and unit are only used for the text output.
+    void result(const std::string &key, double v, const std::string &label, const std::string &unit) {
+        results_.push_back({key, number(v)});
+        char line[160];
+        std::snprintf(line, sizeof(line), "%-36s %12.2f %s\n", (label + ":").c_str(), v, unit.c_str());
+        text_ += line;
+    }
+
+    void print() const {
+        if (!json_) {
+            for (auto &p : params_) std::printf("%-36s %12s\n", (p.first + ":").c_str(), unquote(p.second).c_str());
+            std::fputs(text_.c_str(), stdout);
+            return;
+        }
+        char stamp[32];
+        std::time_t now = std::time(nullptr);
+        std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+        std::printf("{\"bench\":\"%s\",\"time\":\"%s\",\"params\":{%s},\"results\":{%s}}\n",
+                    name_.c_str(), stamp, join(params_).c_str(), join(results_).c_str());
+    }
+
+private:
+    using Fields = std::vector<std::pair<std::string, std::string>>;
+
+    static std::string number(double v) {
+        char b[64];
+        std::snprintf(b, sizeof(b), "%.10g", v);
+        return b;
+    }
+    static std::string unquote(const std::string &v) {
+        return v.size() >= 2 && v.front() == '"' ? v.substr(1, v.size() - 2) : v;
+    }
+    static std::string join(const Fields &f) {
+        std::string out;
+        for (auto &kv : f) out += (out.empty() ? "\"" : ",\"") + kv.first + "\":" + kv.second;
+        return out;
+    }
+
+    std::string name_;
+    bool json_ = false;
+    Fields params_, results_;
+    std::string text_;
+};
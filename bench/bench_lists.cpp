@@ -0,0 +1,68 @@
+// List storage at scale: save_list / load_list on a list of 1M URLs, counting
+// it through the list index (recount and cached), replaying a journal of
+// completions, compacting it, and a bulk import.
+//   g++ -std=c++17 -O2 -pthread bench/bench_lists.cpp -o bench_lists
+//   ./bench_lists [urls] [--json]
+
+#define STREAMHARVESTER_NO_MAIN
+#include "../StreamHarvester.cpp"
+#include "bench_json.h"
+
+template <class F>
+static double time_ms(F fn) {
+    auto t0 = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int main(int argc, char **argv) {
+    BenchReport report("lists", argc, argv);
+    size_t n = argc > 1 ? std::stoul(argv[1]) : 1000000;
+
+    fs::path work = fs::temp_directory_path() / ("sh_bench_lists_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    fs::create_directories(work);
+    fs::current_path(work);
+
+    std::vector<std::string> urls;
+    urls.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        char id[12];
+        for (int k = 0; k < 11; ++k) id[k] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-_"[(i * 2654435761u >> (k * 2)) % 64];
+        id[11] = 0;
+        urls.push_back(std::string("https://www.youtube.com/watch?v=") + id + "&i=" + std::to_string(i));
+    }
+    report.param("urls", (double)n);
+
+    size_t loaded = 0;
+    report.result("save_ms", time_ms([&] { save_list("big", urls); }), "save_list", "ms");
+    report.result("load_ms", time_ms([&] { loaded = load_list("big").size(); }), "load_list", "ms");
+    report.result("stream_ms", time_ms([&] { ListCursor c("big"); for (std::string u; c.next(u);) {} }), "ListCursor walk", "ms");
+    report.result("count_ms", time_ms([&] { list_info("big"); }), "list_info (recount)", "ms");
+    report.result("count_cached_ms", time_ms([&] { list_info("big"); }), "list_info (index hit)", "ms");
+
+    // a run that finished every tenth URL before being killed
+    std::vector<std::string> done;
+    for (size_t i = 0; i < n; i += 10) done.push_back(urls[i]);
+    {
+        ListJournal journal("big");
+        report.result("journal_ms", time_ms([&] { journal.record_done_all(done); }), "journal 10% done", "ms");
+        report.result("load_journal_ms", time_ms([&] { loaded = load_list("big").size(); }), "load_list + journal replay", "ms");
+        report.result("compact_ms", time_ms([&] { journal.compact(); }), "compact", "ms");
+    }
+    if (loaded != n - done.size()) std::fprintf(stderr, "warning: %zu URLs after replay, expected %zu\n", loaded, n - done.size());
+
+    {
+        std::ofstream f("import.txt");
+        for (auto &u : urls) f << u << "\n";
+    }
+    delete_list("big");
+    ImportStats st;
+    double importMs = time_ms([&] { import_urls("big", "import.txt", st); });
+    report.result("import_ms", importMs, "import_urls (dedup + archive)", "ms");
+    report.result("import_urls_per_s", st.added / (importMs / 1000), "import rate", "URLs/s");
+    report.print();
+
+    fs::current_path(fs::temp_directory_path());
+    fs::remove_all(work);
+    return 0;
+}
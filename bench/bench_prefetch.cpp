@@ -0,0 +1,81 @@
+// Metadata prefetch: the same URLs of mixed sizes through DownloadPool with
+// prefetch off, on in list order, and on with smallest-first ordering, against
+// a fake_yt_dlp whose extraction is slow. Reports wall time and the mean time
+// until a URL is done.
+//   g++ -std=c++17 -O2 bench/fake_yt_dlp.cpp -o fake_yt_dlp
+//   g++ -std=c++17 -O2 -pthread bench/bench_prefetch.cpp -o bench_prefetch
+//   ./bench_prefetch ./fake_yt_dlp [urls] [jobs] [--json]
+
+#define STREAMHARVESTER_NO_MAIN
+#include "../StreamHarvester.cpp"
+#include "bench_json.h"
+
+struct PrefetchRun { double wallS = 0, meanDoneS = 0; };
+
+static PrefetchRun run_pool(const std::string &stub, const std::vector<std::string> &urls, int jobs, bool prefetch, const char *order) {
+    Config cfg;
+    cfg.jobs = jobs;
+    cfg.perHost = jobs;
+    cfg.prefetch = prefetch;
+    cfg.order = order;
+    std::error_code ec;
+    fs::remove_all(InfoCache::dir(), ec);
+    std::ofstream devnull;
+    auto *oldOut = std::cout.rdbuf(devnull.rdbuf());
+    auto t0 = std::chrono::steady_clock::now();
+    double doneSum = 0;
+    {
+        DownloadPool pool(cfg, stub, "");
+        pool.onFinish = [&](const PoolEntry &) {
+            doneSum += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        };
+        pool.run("bench", urls);
+    }
+    PrefetchRun r;
+    r.wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    r.meanDoneS = doneSum / urls.size();
+    std::cout.rdbuf(oldOut);
+    return r;
+}
+
+int main(int argc, char **argv) {
+    BenchReport report("prefetch", argc, argv);
+    if (argc < 2) { std::fprintf(stderr, "usage: %s <fake_yt_dlp> [urls] [jobs] [--json]\n", argv[0]); return 2; }
+    std::string stub = fs::absolute(argv[1]).string();
+    int n = argc > 2 ? std::atoi(argv[2]) : 48;
+    int jobs = argc > 3 ? std::atoi(argv[3]) : 4;
+
+    fs::path work = fs::temp_directory_path() / ("sh_bench_prefetch_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    fs::create_directories(work);
+    fs::current_path(work);
+    // 100 ms per MiB, 300 ms of extraction per URL
+#ifdef _WIN32
+    _putenv_s("FAKE_YTDLP_STARTUP_MS", "100"); _putenv_s("FAKE_YTDLP_ITEM_MS", "100"); _putenv_s("FAKE_YTDLP_EXTRACT_MS", "300");
+#else
+    setenv("FAKE_YTDLP_STARTUP_MS", "100", 1); setenv("FAKE_YTDLP_ITEM_MS", "100", 1); setenv("FAKE_YTDLP_EXTRACT_MS", "300", 1);
+#endif
+    report.param("urls", n);
+    report.param("jobs", jobs);
+
+    // 0.5 to 8 MiB, in a fixed shuffled order
+    std::vector<std::string> urls;
+    for (int i = 0; i < n; ++i) {
+        unsigned long long bytes = 524288ull * (1 + (hash64(std::to_string(i)) % 16));
+        urls.push_back("https://host" + std::to_string(i % 4) + ".example.com/v?id=" + std::to_string(i) + "&bytes=" + std::to_string(bytes));
+    }
+    PrefetchRun off = run_pool(stub, urls, jobs, false, "fifo");
+    PrefetchRun fifo = run_pool(stub, urls, jobs, true, "fifo");
+    PrefetchRun sjf = run_pool(stub, urls, jobs, true, "sjf");
+
+    report.result("off_wall_s", off.wallS, "off: wall time", "s");
+    report.result("off_mean_done_s", off.meanDoneS, "off: mean time to done", "s");
+    report.result("fifo_wall_s", fifo.wallS, "prefetch fifo: wall time", "s");
+    report.result("fifo_mean_done_s", fifo.meanDoneS, "prefetch fifo: mean time to done", "s");
+    report.result("sjf_wall_s", sjf.wallS, "prefetch sjf: wall time", "s");
+    report.result("sjf_mean_done_s", sjf.meanDoneS, "prefetch sjf: mean time to done", "s");
+    report.print();
+
+    fs::current_path(fs::temp_directory_path());
+    fs::remove_all(work);
+    return 0;
+}
@@ -0,0 +1,98 @@
+// Progress parsing micro-benchmark: the old std::regex path over yt-dlp's
+// human-readable "[download]" lines vs. parse_progress_record over the
+// --progress-template records, and the whole JobOutput path (parse + publish
+// into the slot) while a reader polls the slot like the renderer does.
+//   g++ -std=c++17 -O2 -pthread bench/bench_progress.cpp -o bench_progress
+//   ./bench_progress [lines] [--json]
+
+#define STREAMHARVESTER_NO_MAIN
+#include "../StreamHarvester.cpp"
+#include "bench_json.h"
+
+#include <regex>
+
+// The loop body exec_with_progress used before the progress template.
+static size_t legacy_regex_parse(const std::vector<std::string> &lines) {
+    std::regex percentRe(R"(\[download\].*?([0-9]{1,3}(?:\.[0-9])?)%)");
+    std::regex etaRe(R"(ETA\s+([0-9]{2}:[0-9]{2}:[0-9]{2}|[0-9]{2}:[0-9]{2}))");
+    std::smatch m1, m2;
+    std::string line;
+    size_t hits = 0;
+    for (auto &l : lines) {
+        line = l.c_str();
+        if (std::regex_search(line, m1, percentRe)) {
+            std::string pct = m1[1].str();
+            std::string etaStr;
+            if (std::regex_search(line, m2, etaRe)) etaStr = m2[1].str();
+            hits += !pct.empty() + !etaStr.empty();
+        }
+    }
+    return hits;
+}
+
+static size_t template_parse(const std::vector<std::string> &lines) {
+    ProgressRecord r;
+    size_t hits = 0;
+    for (auto &l : lines) {
+        if (parse_progress_record(l.data(), l.size(), r)) hits += (progress_permille(r) >= 0) + (r.eta >= 0);
+    }
+    return hits;
+}
+
+// JobOutput::line for every record while another thread keeps reading the
+// published snapshot; returns how many snapshots the reader took.
+static size_t job_output(const std::vector<std::string> &lines) {
+    JobStatus slot;
+    slot.busy = true;
+    std::atomic<bool> done{false};
+    size_t reads = 0;
+    std::thread reader([&] { while (!done) { reads += slot.shown.load().permille >= 0; } });
+    {
+        JobOutput out(&slot, false, nullptr);
+        for (auto &l : lines) out.line(l);
+    }
+    done = true;
+    reader.join();
+    return reads;
+}
+
+template <class F>
+static double lines_per_sec(F fn, const std::vector<std::string> &lines, size_t &hits) {
+    auto t0 = std::chrono::steady_clock::now();
+    hits = fn(lines);
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return lines.size() / s;
+}
+
+int main(int argc, char **argv) {
+    BenchReport report("progress", argc, argv);
+    size_t n = argc > 1 ? std::stoul(argv[1]) : 200000;
+    std::vector<std::string> legacy, tmpl;
+    legacy.reserve(n); tmpl.reserve(n);
+    const uint64_t total = 734003200;
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t done = total * (i % 1000) / 1000;
+        int eta = (int)(1000 - i % 1000);
+        char b[256];
+        std::snprintf(b, sizeof(b), "[download]  %5.1f%% of ~ 700.00MiB at    3.21MiB/s ETA %02d:%02d (frag %zu/2000)\n",
+                      done * 100.0 / total, eta / 60, eta % 60, i % 2000);
+        legacy.push_back(b);
+        std::snprintf(b, sizeof(b), "[SHP] %llu %llu 3365928.5571 %d downloading\n",
+                      (unsigned long long)done, (unsigned long long)total, eta);
+        tmpl.push_back(b);
+    }
+
+    size_t h1 = 0, h2 = 0;
+    double regexRate = lines_per_sec(legacy_regex_parse, legacy, h1);
+    double scanRate = lines_per_sec(template_parse, tmpl, h2);
+    if (h1 != h2) std::fprintf(stderr, "warning: parsers disagree (%zu vs %zu fields)\n", h1, h2);
+    size_t reads = 0;
+    double publishRate = lines_per_sec(job_output, tmpl, reads);
+    report.param("lines", (double)n);
+    report.result("regex_lines_per_s", regexRate, "regex (legacy)", "lines/s");
+    report.result("template_lines_per_s", scanRate, "template scanner", "lines/s");
+    report.result("speedup", scanRate / regexRate, "speedup", "x");
+    report.result("publish_lines_per_s", publishRate, "JobOutput + slot publish", "lines/s");
+    report.print();
+    return 0;
+}
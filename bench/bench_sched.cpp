@@ -0,0 +1,62 @@
+// Per-job scheduling overhead: a bare spawn + wait of fake_yt_dlp vs. the same
+// zero-work job going through DownloadPool (queue, host caps, argv build,
+// output parsing, bookkeeping), sequentially and with several jobs.
+//   g++ -std=c++17 -O2 bench/fake_yt_dlp.cpp -o fake_yt_dlp
+//   g++ -std=c++17 -O2 -pthread bench/bench_sched.cpp -o bench_sched
+//   ./bench_sched ./fake_yt_dlp [jobs] [--json]
+
+#define STREAMHARVESTER_NO_MAIN
+#include "../StreamHarvester.cpp"
+#include "bench_json.h"
+
+static double pool_ms(const std::string &stub, int n, int jobs) {
+    std::vector<std::string> urls;
+    for (int i = 0; i < n; ++i) urls.push_back("https://host" + std::to_string(i % 16) + ".example.com/v/" + std::to_string(i));
+    Config cfg;
+    cfg.jobs = jobs;
+    cfg.perHost = jobs;
+    std::ofstream devnull;
+    auto *oldOut = std::cout.rdbuf(devnull.rdbuf());
+    auto t0 = std::chrono::steady_clock::now();
+    {
+        DownloadPool pool(cfg, stub, "");
+        pool.run("bench", urls);
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    std::cout.rdbuf(oldOut);
+    return ms;
+}
+
+int main(int argc, char **argv) {
+    BenchReport report("sched", argc, argv);
+    if (argc < 2) { std::fprintf(stderr, "usage: %s <fake_yt_dlp> [jobs] [--json]\n", argv[0]); return 2; }
+    std::string stub = fs::absolute(argv[1]).string();
+    int n = argc > 2 ? std::atoi(argv[2]) : 400;
+
+    fs::path work = fs::temp_directory_path() / ("sh_bench_sched_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    fs::create_directories(work);
+    fs::current_path(work);
+#ifdef _WIN32
+    _putenv_s("FAKE_YTDLP_STARTUP_MS", "0"); _putenv_s("FAKE_YTDLP_ITEM_MS", "0"); _putenv_s("FAKE_YTDLP_PROGRESS", "1");
+#else
+    setenv("FAKE_YTDLP_STARTUP_MS", "0", 1); setenv("FAKE_YTDLP_ITEM_MS", "0", 1); setenv("FAKE_YTDLP_PROGRESS", "1", 1);
+#endif
+    report.param("jobs", n);
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i) run_process({stub, "https://example.com/v/" + std::to_string(i)});
+    double raw = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() / n;
+    double seq = pool_ms(stub, n, 1) / n;
+    double par = pool_ms(stub, n, 8) / n;
+
+    report.result("raw_spawn_ms", raw, "bare spawn + wait", "ms/job");
+    report.result("pool_seq_ms", seq, "pool, 1 job at a time", "ms/job");
+    report.result("overhead_ms", seq - raw, "pool overhead", "ms/job");
+    report.result("pool_par_ms", par, "pool, 8 jobs", "ms/job");
+    report.result("pool_par_jobs_per_s", 1000 / par, "pool throughput, 8 jobs", "jobs/s");
+    report.print();
+
+    fs::current_path(fs::temp_directory_path());
+    fs::remove_all(work);
+    return 0;
+}
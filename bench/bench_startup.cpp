@@ -0,0 +1,82 @@
+// Cold start to first job: time from exec'ing "StreamHarvester run <list>"
+// until the (fake) yt-dlp process for the first URL starts. POSIX only.
+//   g++ -std=c++17 -O2 bench/fake_yt_dlp.cpp -o fake_yt_dlp
+//   g++ -std=c++17 -O2 -pthread StreamHarvester.cpp -o StreamHarvester
+//   g++ -std=c++17 -O2 bench/bench_startup.cpp -o bench_startup
+//   ./bench_startup ./StreamHarvester ./fake_yt_dlp [runs] [--json]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench_json.h"
+
+namespace fs = std::filesystem;
+
+// One run; returns milliseconds until the stub wrote its stamp, or -1.
+static double first_job_ms(const std::string &bin, bool fast, bool dropManifest, int run) {
+    if (dropManifest) fs::remove("internals/tools.manifest");
+    fs::remove("internals/archive.txt");
+    fs::remove("stamp");
+    std::ofstream("internals/lists/bench.txt") << "https://example.com/watch?v=run" << run << "\n";
+
+    long long t0 = std::chrono::steady_clock::now().time_since_epoch().count();
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, 1); dup2(null, 2);
+        if (fast) execl(bin.c_str(), bin.c_str(), "--fast", "run", "bench", (char*)nullptr);
+        else execl(bin.c_str(), bin.c_str(), "run", "bench", (char*)nullptr);
+        _exit(127);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    long long t1 = 0;
+    std::ifstream("stamp") >> t1;
+    return t1 ? (t1 - t0) / 1e6 : -1;
+}
+
+static void add(BenchReport &report, const std::string &key, const std::string &label, std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    if (v.empty() || v[0] < 0) { std::fprintf(stderr, "%s: failed\n", label.c_str()); return; }
+    report.result(key + "_min_ms", v.front(), label + ", min", "ms");
+    report.result(key + "_median_ms", v[v.size() / 2], label + ", median", "ms");
+}
+
+int main(int argc, char **argv) {
+    BenchReport report("startup", argc, argv);
+    if (argc < 3) { std::fprintf(stderr, "usage: %s <StreamHarvester> <fake_yt_dlp> [runs] [--json]\n", argv[0]); return 2; }
+    std::string bin = fs::absolute(argv[1]).string(), stub = fs::absolute(argv[2]).string();
+    int runs = argc > 3 ? std::atoi(argv[3]) : 20;
+
+    fs::path work = fs::temp_directory_path() / ("sh_bench_startup_" + std::to_string(getpid()));
+    fs::create_directories(work / "internals" / "lists");
+    fs::current_path(work);
+    fs::copy_file(stub, "internals/yt-dlp");
+    std::ofstream("internals/ffmpeg") << "#!/bin/sh\necho ffmpeg version fake\n";
+    fs::permissions("internals/ffmpeg", fs::perms::owner_all);
+    setenv("FAKE_YTDLP_STAMP", (work / "stamp").c_str(), 1);
+    setenv("FAKE_YTDLP_STARTUP_MS", "0", 1);
+
+    std::vector<double> full, cached, fast;
+    for (int i = 0; i < runs; ++i) full.push_back(first_job_ms(bin, false, true, i));
+    for (int i = 0; i < runs; ++i) cached.push_back(first_job_ms(bin, false, false, i));
+    for (int i = 0; i < runs; ++i) fast.push_back(first_job_ms(bin, true, false, i));
+    report.param("runs", runs);
+    add(report, "full", "no manifest (full tool check)", full);
+    add(report, "cached", "manifest unchanged", cached);
+    add(report, "fast", "manifest unchanged, --fast", fast);
+    report.print();
+
+    fs::current_path(fs::temp_directory_path());
+    fs::remove_all(work);
+    return 0;
+}
@@ -0,0 +1,77 @@
+// Transcode avoidance: the same URLs through DownloadPool with an mp4 target,
+// once with sources the format selector can get as H.264 + AAC (merged into
+// mp4 by yt-dlp, no ffmpeg run) and once with VP9-only sources (re-encoded),
+// against fake_yt_dlp acting as both yt-dlp and ffmpeg. Reports wall time and
+// the ffmpeg time per URL.
+//   g++ -std=c++17 -O2 bench/fake_yt_dlp.cpp -o fake_yt_dlp
+//   g++ -std=c++17 -O2 -pthread bench/bench_transcode.cpp -o bench_transcode
+//   ./bench_transcode ./fake_yt_dlp [urls] [jobs] [--json]
+
+#define STREAMHARVESTER_NO_MAIN
+#include "../StreamHarvester.cpp"
+#include "bench_json.h"
+
+struct TranscodeRun { double wallS = 0, postS = 0; size_t recoded = 0; };
+
+static TranscodeRun run_pool(const std::string &stub, const std::string &ff, int n, int jobs, bool vp9only) {
+    std::vector<std::string> urls;
+    for (int i = 0; i < n; ++i)
+        urls.push_back("https://host" + std::to_string(i % 4) + ".example.com/v?id=" + std::string(vp9only ? "vp9only" : "h264") + std::to_string(i));
+    Config cfg;
+    cfg.jobs = jobs;
+    cfg.perHost = jobs;
+    cfg.targetFormat = "mp4";
+    TranscodeRun r;
+    std::ofstream devnull;
+    auto *oldOut = std::cout.rdbuf(devnull.rdbuf());
+    auto t0 = std::chrono::steady_clock::now();
+    {
+        DownloadPool pool(cfg, stub, ff);
+        pool.onFinish = [&](const PoolEntry &e) {
+            r.postS += e.m.postSec;
+            r.recoded += e.m.conversion && std::strcmp(e.m.conversion, "recode") == 0;
+        };
+        pool.run("bench", urls);
+    }
+    r.wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    r.postS /= n;
+    std::cout.rdbuf(oldOut);
+    fs::remove_all("downloads");
+    return r;
+}
+
+int main(int argc, char **argv) {
+    BenchReport report("transcode", argc, argv);
+    if (argc < 2) { std::fprintf(stderr, "usage: %s <fake_yt_dlp> [urls] [jobs] [--json]\n", argv[0]); return 2; }
+    std::string stub = fs::absolute(argv[1]).string();
+    int n = argc > 2 ? std::atoi(argv[2]) : 16;
+    int jobs = argc > 3 ? std::atoi(argv[3]) : 4;
+
+    fs::path work = fs::temp_directory_path() / ("sh_bench_transcode_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    fs::create_directories(work);
+    fs::current_path(work);
+    std::string ff = (work / "ffmpeg").string();
+    fs::copy_file(stub, ff);
+#ifdef _WIN32
+    _putenv_s("FAKE_YTDLP_STARTUP_MS", "50"); _putenv_s("FAKE_YTDLP_ITEM_MS", "100"); _putenv_s("FAKE_FFMPEG_MS", "1000");
+#else
+    setenv("FAKE_YTDLP_STARTUP_MS", "50", 1); setenv("FAKE_YTDLP_ITEM_MS", "100", 1); setenv("FAKE_FFMPEG_MS", "1000", 1);
+#endif
+    report.param("urls", n);
+    report.param("jobs", jobs);
+
+    TranscodeRun vp9 = run_pool(stub, ff, n, jobs, true);
+    TranscodeRun h264 = run_pool(stub, ff, n, jobs, false);
+
+    report.result("vp9_wall_s", vp9.wallS, "VP9 sources: wall time", "s");
+    report.result("vp9_post_s", vp9.postS, "VP9 sources: ffmpeg per URL", "s");
+    report.result("h264_wall_s", h264.wallS, "H.264 sources: wall time", "s");
+    report.result("h264_post_s", h264.postS, "H.264 sources: ffmpeg per URL", "s");
+    report.result("vp9_recoded", (double)vp9.recoded, "VP9 sources: re-encoded", "URLs");
+    report.result("h264_recoded", (double)h264.recoded, "H.264 sources: re-encoded", "URLs");
+    report.print();
+
+    fs::current_path(fs::temp_directory_path());
+    fs::remove_all(work);
+    return 0;
+}
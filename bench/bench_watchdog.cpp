@@ -0,0 +1,78 @@
+// Watchdog against silent phases: with stall_timeout=1, N URLs whose ffmpeg
+// merge and N whose external download print nothing for longer than that,
+// next to one URL that really hangs, through download_and_cleanup against
+// fake_yt_dlp. The silent ones must finish without a kill; the hanging one is
+// killed, requeued and resumed.
+//   g++ -std=c++17 -O2 bench/fake_yt_dlp.cpp -o fake_yt_dlp
+//   g++ -std=c++17 -O2 -pthread bench/bench_watchdog.cpp -o bench_watchdog
+//   ./bench_watchdog ./fake_yt_dlp [urls] [silent_ms] [--json]
+
+#define STREAMHARVESTER_NO_MAIN
+#include "../StreamHarvester.cpp"
+#include "bench_json.h"
+
+static double json_number(const std::string &line, const char *key) {
+    size_t p = line.find(std::string("\"") + key + "\":");
+    return p == std::string::npos ? 0 : std::atof(line.c_str() + p + std::strlen(key) + 3);
+}
+
+int main(int argc, char **argv) {
+    BenchReport report("watchdog", argc, argv);
+    if (argc < 2) { std::fprintf(stderr, "usage: %s <fake_yt_dlp> [urls] [silent_ms] [--json]\n", argv[0]); return 2; }
+    std::string stub = fs::absolute(argv[1]).string();
+    int n = argc > 2 ? std::atoi(argv[2]) : 4;
+    long silentMs = argc > 3 ? std::atol(argv[3]) : 3000;
+    Config cfg;
+    cfg.stallTimeout = 1;
+    cfg.jobs = 2 * n + 1;
+    cfg.perHost = cfg.jobs;
+
+    fs::path work = fs::temp_directory_path() / ("sh_bench_watchdog_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    fs::create_directories(work);
+    fs::current_path(work);
+#ifdef _WIN32
+    _putenv_s("FAKE_YTDLP_STARTUP_MS", "50"); _putenv_s("FAKE_YTDLP_ITEM_MS", "500");
+#else
+    setenv("FAKE_YTDLP_STARTUP_MS", "50", 1); setenv("FAKE_YTDLP_ITEM_MS", "500", 1);
+#endif
+    report.param("urls", 2 * n + 1);
+    report.param("stall_timeout_s", cfg.stallTimeout);
+    report.param("silent_ms", (double)silentMs);
+
+    std::vector<std::string> urls;
+    for (int i = 0; i < n; ++i) {
+        urls.push_back("https://example.com/merge=" + std::to_string(silentMs) + "/watch?v=merge" + std::to_string(i));
+        urls.push_back("https://example.com/silent=" + std::to_string(silentMs) + "/watch?v=extdl" + std::to_string(i));
+    }
+    urls.push_back("https://example.com/watch?v=stall0");
+    save_list("bench", urls);
+    ToolInstaller ti;
+    fs::copy_file(stub, ti.yt_dlp_path(), fs::copy_options::overwrite_existing);
+
+    std::ofstream devnull;
+    auto *oldOut = std::cout.rdbuf(devnull.rdbuf());
+    auto *oldErr = std::cerr.rdbuf(devnull.rdbuf());
+    auto t0 = std::chrono::steady_clock::now();
+    download_and_cleanup("bench", cfg, ti);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cout.rdbuf(oldOut);
+    std::cerr.rdbuf(oldErr);
+
+    int silentKills = 0, stallKills = 0;
+    size_t ok = 0;
+    std::ifstream metrics(METRICS_LOG);
+    for (std::string line; std::getline(metrics, line);) {
+        int kills = (int)json_number(line, "stalls") + (int)json_number(line, "timeouts");
+        (line.find("stall0") != std::string::npos ? stallKills : silentKills) += kills;
+        ok += line.find("\"ok\":true") != std::string::npos;
+    }
+    report.result("ok", (double)ok, "URLs downloaded", "URLs");
+    report.result("silent_kills", silentKills, "kills of silent merges/downloads (want 0)", "kills");
+    report.result("stall_kills", stallKills, "kills of the hanging URL (want >= 1)", "kills");
+    report.result("wall_s", secs, "wall time", "s");
+    report.print();
+
+    fs::current_path(fs::temp_directory_path());
+    fs::remove_all(work);
+    return silentKills == 0 && stallKills > 0 && ok == urls.size() ? 0 : 1;
+}
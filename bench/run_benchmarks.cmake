@@ -0,0 +1,51 @@
+# Runs the benchmark suite with --json; invoked by the "bench" target:
+#   cmake -DBIN_DIR=<dir with the binaries> -DOUT_DIR=<results dir>
+#         -DBENCHES=progress,lists,... -P bench/run_benchmarks.cmake
+# Each benchmark's JSON object goes to OUT_DIR/<name>.json; all of them are
+# also appended, one per line, to OUT_DIR/history.jsonl for comparing runs.
+
+if(NOT BIN_DIR OR NOT OUT_DIR)
+  message(FATAL_ERROR "BIN_DIR and OUT_DIR are required")
+endif()
+if(BENCHES)
+  string(REPLACE "," ";" BENCHES "${BENCHES}")
+else()
+  set(BENCHES progress lists sched batch e2e adaptive prefetch transcode catalog watchdog startup)
+endif()
+if(CMAKE_HOST_WIN32)
+  set(exe ".exe")
+else()
+  set(exe "")
+endif()
+file(MAKE_DIRECTORY "${OUT_DIR}")
+set(stub "${BIN_DIR}/fake_yt_dlp${exe}")
+
+# per-benchmark arguments, sized to finish in well under a minute each
+set(args_progress 200000)
+set(args_lists 1000000)
+set(args_sched "${stub}" 400)
+set(args_batch "${stub}" 40 20)
+set(args_e2e "${stub}" 200 8 1 0.05)
+set(args_adaptive "${stub}" 120)
+set(args_prefetch "${stub}" 48 4)
+set(args_transcode "${stub}" 16 4)
+set(args_catalog 300000)
+set(args_watchdog "${stub}" 4 3000)
+set(args_startup "${BIN_DIR}/StreamHarvester${exe}" "${stub}" 20)
+
+foreach(b IN LISTS BENCHES)
+  message(STATUS "bench_${b}")
+  execute_process(
+    COMMAND "${BIN_DIR}/bench_${b}${exe}" ${args_${b}} --json
+    WORKING_DIRECTORY "${OUT_DIR}"
+    OUTPUT_VARIABLE out
+    RESULT_VARIABLE rc)
+  if(NOT rc EQUAL 0)
+    message(WARNING "bench_${b} failed (${rc})")
+    continue()
+  endif()
+  string(STRIP "${out}" out)
+  file(WRITE "${OUT_DIR}/${b}.json" "${out}\n")
+  file(APPEND "${OUT_DIR}/history.jsonl" "${out}\n")
+  message(STATUS "  ${out}")
+endforeach()